@@ -0,0 +1,231 @@
+#ifndef CPPSTDDB_ADMISSION_H
+#define CPPSTDDB_ADMISSION_H
+
+#include <cppstddb/result.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/*
+   Admission control for a database: at most limit queries in flight, the
+   rest wait in one of two priority classes.  Interactive waiters always go
+   first, batch queries may only hold batch_share of the limit, so batch
+   traffic can neither queue ahead of interactive work nor fill the
+   backend.  A wait ends in rejection at the class's queue timeout (or the
+   statement deadline, if sooner), immediately when the class already has
+   max_queue waiters.
+
+   With a target latency the limit adapts (AIMD on interactive latency):
+   it shrinks by a tenth when a query is slower than the target, at most
+   once per target interval, and grows by one per limit of fast queries
+   finishing while the limit is in use.
+
+     auto a = std::make_shared<admission_control>();
+     db.admission(a);
+     auto con = db.connection();
+     con.priority(priority_class::batch);
+ */
+
+namespace cppstddb {
+
+    enum class priority_class {interactive, batch};
+
+    struct admission_stats {
+        int limit = 0;
+        int in_flight = 0;
+        int queued[2] = {0, 0};     // by priority_class
+        uint64_t admitted = 0;
+        uint64_t rejected = 0;      // queue full, or timed out waiting
+    };
+
+    class admission_control {
+        public:
+            using clock_type = std::chrono::steady_clock;
+            using time_point = clock_type::time_point;
+
+            struct options {
+                int limit = 16;                     // initial in-flight limit
+                int min_limit = 1;
+                int max_limit = 256;
+                double batch_share = 0.5;           // of the limit usable by batch
+                int max_queue = 1024;               // waiters per class
+                std::chrono::milliseconds interactive_timeout{100};
+                std::chrono::milliseconds batch_timeout{10000};
+                std::chrono::microseconds target_latency{0}; // 0: fixed limit
+            };
+
+            /*
+               a slot, held while the query runs; the latency the limit adapts
+               to ends at served() (the first fetch), not at the release, so a
+               slow consumer of the rows does not count as a slow backend
+             */
+            class permit {
+                public:
+                    permit():control_(nullptr),priority_(priority_class::interactive),start_(),served_() {}
+
+                    permit(permit&& other):
+                        control_(other.control_),
+                        priority_(other.priority_),
+                        start_(other.start_),
+                        served_(other.served_) {
+                            other.control_ = nullptr;
+                        }
+
+                    permit& operator=(permit&& other) {
+                        std::swap(control_, other.control_);
+                        std::swap(priority_, other.priority_);
+                        std::swap(start_, other.start_);
+                        std::swap(served_, other.served_);
+                        return *this;
+                    }
+
+                    ~permit() {
+                        if (!control_) return;
+                        auto end = served_ == time_point() ? clock_type::now() : served_;
+                        control_->release(priority_, end - start_);
+                    }
+
+                    explicit operator bool() const {return control_ != nullptr;}
+
+                    // the backend has answered: the latency is measured up to now
+                    void served() {
+                        if (served_ == time_point()) served_ = clock_type::now();
+                    }
+
+                private:
+                    friend class admission_control;
+                    admission_control* control_;
+                    priority_class priority_;
+                    time_point start_;
+                    time_point served_;
+
+                    permit(admission_control* c, priority_class p):control_(c),priority_(p),start_(clock_type::now()),served_() {}
+            };
+
+            admission_control():admission_control(options()) {}
+
+            admission_control(const options& o):
+                options_(o),
+                limit_(std::max(o.limit, 1)),
+                in_flight_(0),
+                batch_in_flight_(0),
+                waiting_{0, 0},
+                admitted_(0),
+                rejected_(0),
+                credit_(0),
+                last_decrease_() {}
+
+            admission_control(const admission_control&) = delete;
+            admission_control& operator=(const admission_control&) = delete;
+
+            // wait for a slot until the class timeout or deadline, an overloaded error if none
+            result<permit> try_admit(priority_class p, time_point deadline = time_point::max()) {
+                int c = static_cast<int>(p);
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (can_run(p)) return grant(p);
+
+                if (waiting_[c] >= options_.max_queue) return reject("admission: queue full");
+                auto timeout = p == priority_class::interactive ? options_.interactive_timeout : options_.batch_timeout;
+                auto until = std::min(deadline, clock_type::now() + timeout);
+
+                ++waiting_[c];
+                bool ready = cv_[c].wait_until(lock, until, [this, p] {return can_run(p);});
+                --waiting_[c];
+                if (!ready) {
+                    wake(); // batch may go now that this one left
+                    return reject("admission: queue timeout");
+                }
+                return grant(p);
+            }
+
+            permit admit(priority_class p, time_point deadline = time_point::max()) {
+                auto r = try_admit(p, deadline);
+                return std::move(r.value());
+            }
+
+            admission_stats stats() const {
+                std::lock_guard<std::mutex> lock(mutex_);
+                admission_stats s;
+                s.limit = limit_;
+                s.in_flight = in_flight_;
+                s.queued[0] = waiting_[0];
+                s.queued[1] = waiting_[1];
+                s.admitted = admitted_;
+                s.rejected = rejected_;
+                return s;
+            }
+
+        private:
+            options options_;
+            int limit_;
+            int in_flight_;
+            int batch_in_flight_;
+            int waiting_[2];
+            uint64_t admitted_;
+            uint64_t rejected_;
+            double credit_;             // additive increase, a whole slot at 1
+            time_point last_decrease_;
+
+            mutable std::mutex mutex_;
+            std::condition_variable cv_[2];
+
+            int batch_limit() const {
+                return std::max(1, static_cast<int>(limit_ * options_.batch_share));
+            }
+
+            bool can_run(priority_class p) const {
+                if (in_flight_ >= limit_) return false;
+                if (p == priority_class::interactive) return true;
+                return !waiting_[0] && batch_in_flight_ < batch_limit();
+            }
+
+            // under the lock
+            permit grant(priority_class p) {
+                ++in_flight_;
+                if (p == priority_class::batch) ++batch_in_flight_;
+                ++admitted_;
+                return permit(this, p);
+            }
+
+            error reject(const char* why) {
+                ++rejected_;
+                return error(error_kind::overloaded, why, 0);
+            }
+
+            void release(priority_class p, clock_type::duration latency) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (p == priority_class::batch) --batch_in_flight_;
+                if (p == priority_class::interactive && options_.target_latency.count()) adapt(latency);
+                --in_flight_;
+                wake();
+            }
+
+            void adapt(clock_type::duration latency) {
+                auto now = clock_type::now();
+                if (latency > options_.target_latency) {
+                    if (now - last_decrease_ < options_.target_latency) return;
+                    limit_ = std::max(options_.min_limit, std::min(limit_ - 1, static_cast<int>(limit_ * 0.9)));
+                    limit_ = std::max(limit_, 1);
+                    last_decrease_ = now;
+                    credit_ = 0;
+                } else if (in_flight_ >= limit_) {
+                    credit_ += 1.0 / limit_;
+                    if (credit_ >= 1) {
+                        limit_ = std::min(options_.max_limit, limit_ + 1);
+                        credit_ = 0;
+                    }
+                }
+            }
+
+            // under the lock
+            void wake() {
+                if (waiting_[0]) cv_[0].notify_all();
+                else if (waiting_[1]) cv_[1].notify_all();
+            }
+    };
+
+}
+
+#endif
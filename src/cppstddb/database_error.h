@@ -61,12 +61,11 @@ namespace cppstddb {
     }
 
 
-    void database_error::build() {
-        std::stringstream s;
-        s << "message: " << message_;
-        if (retcode_) s << ", retcode: " << retcode_;
-        if (!driver_message_.empty()) s << ", driver_message: " << driver_message_;
-        what_ = s.str();
+    inline void database_error::build() {
+        what_.reserve(message_.size() + driver_message_.size() + 48);
+        what_.append("message: ").append(message_);
+        if (retcode_) what_.append(", retcode: ").append(std::to_string(retcode_));
+        if (!driver_message_.empty()) what_.append(", driver_message: ").append(driver_message_);
     }
 
     inline database_error::~database_error() throw() {
@@ -76,6 +75,20 @@ namespace cppstddb {
         return what_.c_str();
     }
 
+    // raised when a statement deadline passes and the query is cancelled
+    class timeout_error : public database_error {
+        public:
+            timeout_error(const string &message):database_error(message) {}
+            timeout_error(const string &message, const string &driver_message):
+                database_error(message, 0, driver_message) {}
+    };
+
+    // raised when admission control turns a query away
+    class overload_error : public database_error {
+        public:
+            overload_error(const string &message):database_error(message) {}
+    };
+
     inline void vertical_print(std::ostream &os, const database_error& e) {
         os
             << "+-- database error -------------------------+\n"
@@ -1,6 +1,7 @@
 #ifndef CPPSTDDB_DATE_H
 #define CPPSTDDB_DATE_H
 #include <iostream>
+#include <chrono>
 
 namespace cppstddb {
 
@@ -25,6 +26,62 @@ namespace cppstddb {
         return os;
     }
 
+    class datetime_t {
+        private:
+            date_t date_;
+            int hour_,minute_,second_,microsecond_;
+
+        public:
+            datetime_t():hour_(0),minute_(0),second_(0),microsecond_(0) {}
+            datetime_t(int y,int m,int d,int h,int mi,int s,int us = 0):
+                date_(y,m,d),hour_(h),minute_(mi),second_(s),microsecond_(us) {}
+
+            const date_t& date() const {return date_;}
+            auto year() const {return date_.year();}
+            auto month() const {return date_.month();}
+            auto day() const {return date_.day();}
+            auto hour() const {return hour_;}
+            auto minute() const {return minute_;}
+            auto second() const {return second_;}
+            auto microsecond() const {return microsecond_;}
+    };
+
+    inline std::ostream& operator<<(std::ostream &os, const datetime_t& d) {
+        auto fill = os.fill('0');
+        os << d.date() << ' ';
+        os.width(2); os << d.hour() << ':';
+        os.width(2); os << d.minute() << ':';
+        os.width(2); os << d.second();
+        if (d.microsecond()) {
+            os << '.';
+            os.width(6); os << d.microsecond();
+        }
+        os.fill(fill);
+        return os;
+    }
+
+    // a time of day or interval as [-]hh:mm:ss[.ffffff]
+    inline void write_time(std::ostream &os, std::chrono::microseconds t) {
+        using namespace std::chrono;
+        if (t.count() < 0) {
+            os << '-';
+            t = -t;
+        }
+        auto fill = os.fill('0');
+        auto h = duration_cast<hours>(t);
+        auto m = duration_cast<minutes>(t - h);
+        auto s = duration_cast<seconds>(t - h - m);
+        auto us = (t - h - m - s).count();
+        os.width(2); os << h.count() << ':';
+        os.width(2); os << m.count() << ':';
+        os.width(2); os << s.count();
+        if (us) {
+            os << '.';
+            os.width(6); os << us;
+        }
+        os.fill(fill);
+    }
+
 }
 
 #endif
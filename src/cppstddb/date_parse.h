@@ -32,7 +32,7 @@ namespace cppstddb {
         static int parseYyyyMmDd(const char *zDate, DateTime *p);
 
         template<class S> date_t date_parse(const S& s) {
-            DateTime dt;
+            DateTime dt{}; // the parser reads the valid and tz flags it does not set
             parseYyyyMmDd(s.c_str(), &dt);
             return date_t(dt.Y,dt.M,dt.D);
         }
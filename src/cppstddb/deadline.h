@@ -0,0 +1,182 @@
+#ifndef CPPSTDDB_DEADLINE_H
+#define CPPSTDDB_DEADLINE_H
+
+#include <cppstddb/log.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+
+/*
+   A single background thread that runs a callback (typically a driver
+   cancel) when a registered deadline passes.  Used by the front end to
+   enforce statement timeouts in the same way for every driver.
+
+   A guard is armed once per query and marks each blocking call with
+   enter()/leave(), which take no lock.  The callback only runs when the
+   deadline passes inside a call; one that passes between calls is seen
+   by the next enter().  disarm() waits for a callback in flight.
+ */
+
+namespace cppstddb {
+
+    class deadline_timer {
+        public:
+            using clock_type = std::chrono::steady_clock;
+            using time_point = clock_type::time_point;
+            using callback = std::function<void()>;
+            using guard_t = std::lock_guard<std::mutex>;
+
+            struct entry {
+                time_point deadline;
+                callback on_expire;
+                std::atomic<bool> fired;
+                std::atomic<bool> active;   // inside a guarded call
+                entry(time_point d, callback c):deadline(d),on_expire(c),fired(false),active(false) {}
+            };
+
+            using entry_ptr = std::shared_ptr<entry>;
+
+            static deadline_timer& instance() {
+                static deadline_timer timer;
+                return timer;
+            }
+
+            deadline_timer():running_(nullptr),stop_(false) {}
+
+            ~deadline_timer() {
+                {
+                    guard_t guard(mutex_);
+                    stop_ = true;
+                }
+                cv_.notify_one();
+                if (thread_.joinable()) thread_.join();
+            }
+
+            void add(const entry_ptr& e) {
+                guard_t guard(mutex_);
+                if (!thread_.joinable()) thread_ = std::thread([this]{run();});
+                entries_.emplace(e->deadline, e);
+                cv_.notify_one();
+            }
+
+            // returns once e is neither pending nor running its callback
+            void remove(const entry_ptr& e) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                auto r = entries_.equal_range(e->deadline);
+                for(auto i = r.first; i != r.second; ++i) {
+                    if (i->second == e) {
+                        entries_.erase(i);
+                        break;
+                    }
+                }
+                done_.wait(lock, [this, &e]{return running_ != e.get();});
+            }
+
+        private:
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            std::condition_variable done_;
+            std::multimap<time_point, entry_ptr> entries_;
+            entry* running_; // callback in flight
+            std::thread thread_;
+            bool stop_;
+
+            void run() {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (!stop_) {
+                    if (entries_.empty()) {
+                        cv_.wait(lock);
+                        continue;
+                    }
+                    auto i = entries_.begin();
+                    if (clock_type::now() < i->first) {
+                        cv_.wait_until(lock, i->first);
+                        continue;
+                    }
+                    auto e = i->second;
+                    entries_.erase(i);
+                    e->fired = true;
+                    if (!e->active) continue; // between calls: enter() sees fired
+
+                    // callbacks may block (mysql opens a side connection)
+                    running_ = e.get();
+                    lock.unlock();
+                    try {
+                        e->on_expire();
+                    } catch (std::exception& ex) {
+                        DB_WARN("deadline callback error (ignored): " << ex.what());
+                    }
+                    lock.lock();
+                    running_ = nullptr;
+                    done_.notify_all();
+                }
+            }
+    };
+
+    class deadline_guard {
+        public:
+            using clock_type = deadline_timer::clock_type;
+            using time_point = deadline_timer::time_point;
+
+            deadline_guard():armed_(false) {}
+
+            template<class F> deadline_guard(time_point deadline, F on_expire):deadline_guard() {
+                arm(deadline, on_expire);
+            }
+
+            ~deadline_guard() {disarm();}
+
+            deadline_guard(const deadline_guard&) = delete;
+            deadline_guard& operator=(const deadline_guard&) = delete;
+
+            // start the clock, the entry (and on_expire) is kept from the first arm
+            template<class F> void arm(time_point deadline, F on_expire) {
+                disarm();
+                if (!entry_) {
+                    entry_ = std::make_shared<deadline_timer::entry>(deadline, on_expire);
+                } else {
+                    entry_->deadline = deadline;
+                    entry_->fired = false;
+                }
+                deadline_timer::instance().add(entry_);
+                armed_ = true;
+            }
+
+            // waits for a callback in flight
+            void disarm() {
+                if (!armed_) return;
+                deadline_timer::instance().remove(entry_);
+                armed_ = false;
+            }
+
+            bool armed() const {return armed_;}
+
+            // mark the start of a blocking call, false when the deadline has passed
+            bool enter() {
+                entry_->active = true;
+                if (entry_->fired || clock_type::now() >= entry_->deadline) {
+                    entry_->active = false;
+                    return false;
+                }
+                return true;
+            }
+
+            void leave() {entry_->active = false;}
+
+            bool fired() const {return entry_ && entry_->fired;}
+
+        private:
+            deadline_timer::entry_ptr entry_;
+            bool armed_;
+    };
+
+}
+
+#endif
+
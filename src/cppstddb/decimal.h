@@ -0,0 +1,87 @@
+#ifndef CPPSTDDB_DECIMAL_H
+#define CPPSTDDB_DECIMAL_H
+
+#include <cppstddb/database_error.h>
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+namespace cppstddb {
+
+    // fixed point decimal: value() * 10^-scale()
+
+    class decimal_t {
+        private:
+            int64_t value_;
+            int scale_;
+
+        public:
+            decimal_t():value_(0),scale_(0) {}
+            decimal_t(int64_t value, int scale):value_(value),scale_(scale) {}
+
+            auto value() const {return value_;}
+            auto scale() const {return scale_;}
+
+            double to_double() const {
+                double d = value_;
+                for(int i = 0; i != scale_; ++i) d /= 10;
+                return d;
+            }
+
+            // decimal text of any precision as the nearest double
+            static double text_to_double(const char* s, size_t n) {
+                std::string t(s, n);
+                char* end;
+                double d = std::strtod(t.c_str(), &end);
+                if (t.empty() || *end) throw database_error("decimal: bad value: " + t);
+                return d;
+            }
+
+            // from text such as "-123.45", up to 18 significant digits
+            static decimal_t parse(const char* s, size_t n) {
+                auto i = s, e = s + n;
+                bool neg = i != e && *i == '-';
+                if (i != e && (*i == '-' || *i == '+')) ++i;
+                if (i == e) throw database_error("decimal: bad value: " + std::string(s, n));
+
+                uint64_t v = 0;
+                int scale = 0, digits = 0;
+                bool point = false;
+                for(; i != e; ++i) {
+                    if (*i == '.' && !point) {
+                        point = true;
+                        continue;
+                    }
+                    if (*i < '0' || *i > '9') throw database_error("decimal: bad value: " + std::string(s, n));
+                    if (v || *i != '0') ++digits;
+                    if (digits > std::numeric_limits<int64_t>::digits10) {
+                        throw database_error("decimal: too many digits: " + std::string(s, n));
+                    }
+                    v = v * 10 + (*i - '0');
+                    if (point) ++scale;
+                }
+                auto value = static_cast<int64_t>(v);
+                return decimal_t(neg ? -value : value, scale);
+            }
+    };
+
+    inline std::ostream& operator<<(std::ostream &os, const decimal_t& d) {
+        auto v = d.value();
+        uint64_t u = v < 0 ? 0 - static_cast<uint64_t>(v) : v;
+        auto s = std::to_string(u);
+        if (d.scale() > 0) {
+            auto scale = static_cast<size_t>(d.scale());
+            if (s.size() <= scale) s.insert(0, scale - s.size() + 1, '0');
+            s.insert(s.size() - scale, 1, '.');
+        }
+        if (v < 0) os << '-';
+        os << s;
+        return os;
+    }
+
+}
+
+#endif
+
@@ -3,12 +3,30 @@
 #include <string>
 #include <experimental/string_view>
 #include <memory>
+#include <vector>
+#include <type_traits>
+#include <cstdint>
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define CPPSTDDB_HAS_PMR 1
+#endif
+#if __has_include(<ranges>) && __cplusplus > 201703L
+#include <ranges>
+#ifdef __cpp_lib_ranges
+#define CPPSTDDB_HAS_RANGES 1
+#endif
+#endif
 #include <exception>
 #include <cppstddb/log.h>
 #include "database_error.h"
+#include <cppstddb/result.h>
+#include <cppstddb/admission.h>
+#include <cppstddb/deadline.h>
+#include <chrono>
 #include <iostream>
 #include <cppstddb/util.h>
 #include <cppstddb/date.h>
+#include <cppstddb/decimal.h>
 
 namespace cppstddb {
     enum value_type {
@@ -16,13 +34,93 @@ namespace cppstddb {
         value_int,
         value_string,
         value_date,
+        value_int64,
+        value_double,
+        value_blob,
+        value_decimal,
+        value_datetime,
+        value_time,
         value_variant,
     };
 
+    /*
+       prepared: the statement is prepared once and executed with its
+       parameters each query.  direct: nothing is prepared, each query sends
+       the sql and parameters in one round trip (PQexecParams for postgres,
+       mysql_real_query and text protocol rows for mysql, which takes no
+       parameters this way).  The one shot query(sql) calls run direct.
+     */
+    enum class execution {prepared, direct};
+
+    /*
+       a policy supplies the string type and allocator used for statement,
+       describe and result data in the drivers
+     */
+
     class default_policy {
         public:
             using string = std::string;
+            template<class T> using allocator = std::allocator<T>;
+            template<class T> using vector = std::vector<T, allocator<T>>;
+
+            template<class T> static allocator<T> get_allocator() {return allocator<T>();}
+    };
+
+#ifdef CPPSTDDB_HAS_PMR
+    /*
+       allocates from the calling thread's current memory resource (set with
+       scoped_resource), for example a per request monotonic arena that is
+       released in one shot
+     */
+
+    class pmr_policy {
+        public:
+            using string = std::pmr::string;
+            template<class T> using allocator = std::pmr::polymorphic_allocator<T>;
+            template<class T> using vector = std::pmr::vector<T>;
+
+            static std::pmr::memory_resource*& current() {
+                static thread_local std::pmr::memory_resource* resource = nullptr;
+                return resource;
+            }
+
+            static std::pmr::memory_resource* resource() {
+                auto r = current();
+                return r ? r : std::pmr::get_default_resource();
+            }
+
+            template<class T> static allocator<T> get_allocator() {return allocator<T>(resource());}
+    };
+
+    class scoped_resource {
+        public:
+            scoped_resource(std::pmr::memory_resource* r):prev_(pmr_policy::current()) {
+                pmr_policy::current() = r;
+            }
+            ~scoped_resource() {pmr_policy::current() = prev_;}
+
+            scoped_resource(const scoped_resource&) = delete;
+            scoped_resource& operator=(const scoped_resource&) = delete;
+
+        private:
+            std::pmr::memory_resource* prev_;
     };
+#endif
+
+    // build a string of type S, using the policy allocator when S takes it
+
+    template<class P, class S> S make_string(const char* s, size_t n, std::true_type) {
+        return S(s, n, P::template get_allocator<char>());
+    }
+
+    template<class P, class S> S make_string(const char* s, size_t n, std::false_type) {
+        return S(s, n);
+    }
+
+    template<class P, class S> S make_string(const char* s, size_t n) {
+        using same = std::is_same<typename S::allocator_type, typename P::template allocator<char>>;
+        return make_string<P,S>(s, n, same());
+    }
 }
 
 namespace cppstddb { namespace front {
@@ -35,6 +133,17 @@ namespace cppstddb { namespace front {
     template<class D> class field;
 
 
+    // whether driver D reads columns as T (its field_type<T> has as())
+    template<class D, class T, class = void> struct has_field_type : std::false_type {};
+    template<class D, class T> struct has_field_type<D, T,
+        decltype(void(&D::template field_type<T>::as))> : std::true_type {};
+
+    // chunk size for streaming large values
+    const size_t lob_chunk_size = 1 << 16;
+
+    template<class T> void print_value(std::ostream& os, const T& v) {os << v;}
+    inline void print_value(std::ostream& os, std::chrono::microseconds t) {write_time(os, t);}
+
     template<typename T>
         void raise_error(const std::string& msg, const T& t) {
             std::stringstream s;
@@ -55,6 +164,7 @@ namespace cppstddb { namespace front {
             struct data_t {
                 database_type db;
                 string uri;
+                std::shared_ptr<admission_control> admission;
                 data_t() {}
                 data_t(const string& uri_):uri(uri_) {}
             };
@@ -73,17 +183,28 @@ namespace cppstddb { namespace front {
                 }
 
             // helpful for testing
-            string date_column_type() const {return data_->db.date_column_type();}
+            auto date_column_type() const {return data_->db.date_column_type();}
 
             auto uri() const {return data_->uri;}
 
+            // limit queries in flight on this database (null: no limit), shared by its
+            // copies; set it before the database is used from other threads
+            basic_database& admission(std::shared_ptr<admission_control> a) {
+                data_->admission = a;
+                return *this;
+            }
+
+            auto admission() const {return data_->admission;}
+
             auto connection() {return connection_t(*this,false);}
             auto connection(const string& uri) {return connection_t(*this,uri,false);}
             auto create_connection() {return connection_t(*this,true);}
-            auto statement(const string &sql) {return connection().statement(sql);}
+            auto statement(string_view sql, execution mode = execution::prepared) {
+                return connection().statement(sql, mode);
+            }
 
-            auto query(const string& sql) {
-                return statement(sql).query();
+            auto query(string_view sql) {
+                return statement(sql, execution::direct).query();
             }
     };
 
@@ -92,6 +213,7 @@ namespace cppstddb { namespace front {
             using database_type = D;
             using policy_type = typename database_type::policy_type;
             using string = std::string;
+            using string_view = std::experimental::string_view;
             using database_t = basic_database<database_type>;
             using statement_t = statement<database_type>;
             using connection_type = typename database_type::connection;
@@ -100,23 +222,46 @@ namespace cppstddb { namespace front {
             using shared_ptr_type = std::shared_ptr<connection_type>;
             database_t database_;
             shared_ptr_type data_; // data_ -> ptr?
+            std::chrono::milliseconds timeout_;
+            priority_class priority_;
 
         public:
             connection(database_t& database, bool create):
                 database_(database),
-                data_(std::make_shared<connection_type>(database_.data_->db, get_source(database_))) {
+                data_(std::make_shared<connection_type>(database_.data_->db, get_source(database_))),
+                timeout_(0),
+                priority_(priority_class::interactive) {
                 }
 
             connection(database_t& database, const string& uri, bool create):
                 database_(database),
-                data_(std::make_shared<connection_type>(database_.data_->db, get_source(database_, uri))) {
+                data_(std::make_shared<connection_type>(database_.data_->db, get_source(database_, uri))),
+                timeout_(0),
+                priority_(priority_class::interactive) {
                 }
 
-            auto statement(const string &sql) {return statement_t(*this,sql);}
+            auto statement(string_view sql, execution mode = execution::prepared) {
+                return statement_t(*this,sql,mode);
+            }
             auto database() {return database_;}
 
-            auto query(const string& sql) {
-                return statement(sql).query();
+            // default timeout for statements created from this connection (0: none)
+            connection& timeout(std::chrono::milliseconds t) {
+                timeout_ = t;
+                return *this;
+            }
+
+            // admission class for statements created from this connection
+            connection& priority(priority_class p) {
+                priority_ = p;
+                return *this;
+            }
+
+            // cancel the running query, safe to call from another thread
+            void cancel() {data_->cancel();}
+
+            auto query(string_view sql) {
+                return statement(sql, execution::direct).query();
             }
 
         private:
@@ -135,7 +280,8 @@ namespace cppstddb { namespace front {
         public:
             using database_type = D;
             using policy_type = typename database_type::policy_type;
-            using string = std::string;
+            using string = typename policy_type::string;
+            using string_view = std::experimental::string_view;
             using connection_t = connection<database_type>;
             using rowset_t = rowset<database_type>;
             using statement_type = typename database_type::statement;
@@ -148,32 +294,170 @@ namespace cppstddb { namespace front {
                 state_executed
             };
 
+            using clock_type = deadline_timer::clock_type;
+            using time_point = deadline_timer::time_point;
+
             typedef std::shared_ptr<statement_type> shared_ptr_type;
-            connection_t connection_;
-            string sql_;
+            connection_t connection_; // the sql is kept by the driver, copies allocate nothing
             shared_ptr_type data_;
             state_type state_;
+            std::chrono::milliseconds timeout_;
+            time_point deadline_;
+            priority_class priority_;
+            execution execution_;
+
+            // state of the running query, shared with the rowset's copy: kept
+            // from query() until the rows are read, reset() or the next query;
+            // rows() lends the permit to the rowset, whose last copy gives it back
+            struct query_state {
+                deadline_guard deadline;
+                admission_control::permit permit;
+                std::weak_ptr<admission_control::permit> lent;
+            };
+            std::shared_ptr<query_state> query_;
 
         public:
-            statement(connection_t& connection, const string &sql):
+            statement(connection_t& connection, string_view sql, execution mode = execution::prepared):
                 connection_(connection),
-                sql_(sql),
-                data_(std::make_shared<statement_type>(*connection.data_, sql_)),
-                state_(state_undef) {
+                data_(std::make_shared<statement_type>(
+                            *connection.data_,
+                            make_string<policy_type,string>(sql.data(), sql.size()))),
+                state_(state_undef),
+                timeout_(connection.timeout_),
+                deadline_(time_point::max()),
+                priority_(connection.priority_),
+                execution_(mode),
+                query_(std::make_shared<query_state>()) {
                     prepare();
                 }
 
             auto connection() {return connection_;}
             auto database() {return connection_.database();}
 
+            // time allowed for execution and fetching of each query (0: none)
+            statement& timeout(std::chrono::milliseconds t) {
+                timeout_ = t;
+                return *this;
+            }
+
+            statement& priority(priority_class p) {
+                priority_ = p;
+                return *this;
+            }
+
+            // cancel the running query, safe to call from another thread
+            void cancel() {connection_.cancel();}
+
             void prepare() {
-                data_->prepare();
+                if (execution_ == execution::direct) data_->prepare_direct();
+                else data_->prepare();
                 state_ = state_prepared;
             }
 
+            // the query holds an admission permit, when the database has admission
+            // control, until its rows are read or the statement is reset
             auto query() {
-                data_->query();
+                reset();
+                deadline_ = timeout_.count() ? clock_type::now() + timeout_ : time_point::max();
+                if (auto& a = connection_.database_.data_->admission) query_->permit = a->admit(priority_, deadline_);
+                arm();
+                try {
+                    guarded([this]{data_->query();});
+                } catch (...) {
+                    reset();
+                    throw;
+                }
+                state_ = state_executed;
+                return *this;
+            }
+
+            // query() for when failure is routine: the error is returned, not thrown
+            result<void> try_query() {
+                reset();
+                deadline_ = timeout_.count() ? clock_type::now() + timeout_ : time_point::max();
+                if (auto& a = connection_.database_.data_->admission) {
+                    auto r = a->try_admit(priority_, deadline_);
+                    if (!r) return r.error();
+                    query_->permit = std::move(*r);
+                }
+                arm();
+                error e;
+                if (!try_guarded([this, &e]{return data_->try_query(e);}, e)) {
+                    reset();
+                    return keep_source(e);
+                }
                 state_ = state_executed;
+                return result<void>();
+            }
+
+            // the error reads its message from the driver statement or connection, keep both
+            error keep_source(error e) {
+                e.keep(connection_.data_, data_);
+                return e;
+            }
+
+            // the permit of the current query, for the rowset reading it
+            std::shared_ptr<admission_control::permit> lend_permit() {
+                if (!query_->permit) return nullptr;
+                auto p = std::make_shared<admission_control::permit>(std::move(query_->permit));
+                query_->lent = p;
+                return p;
+            }
+
+            // end the current query: stop its deadline clock and give back its permit
+            void reset() {
+                query_->deadline.disarm();
+                query_->permit = admission_control::permit();
+                if (auto p = query_->lent.lock()) *p = admission_control::permit();
+            }
+
+            // start the deadline clock for a query, once for its execute and fetches
+            void arm() {
+                if (deadline_ == time_point::max()) return;
+                auto con = connection_.data_;
+                query_->deadline.arm(deadline_, [con]{con->cancel();});
+            }
+
+            // marks a driver call as running, for the deadline's cancel
+            struct deadline_call {
+                deadline_guard& guard;
+                ~deadline_call() {guard.leave();}
+            };
+
+            // run a blocking driver call under the current deadline
+            template<class F> auto guarded(F f) {
+                if (deadline_ == time_point::max()) return f();
+                auto& guard = query_->deadline;
+                if (!guard.enter()) throw timeout_error("query deadline exceeded");
+                deadline_call call{guard};
+                try {
+                    return f();
+                } catch (database_error& e) {
+                    if (guard.fired()) throw timeout_error("query deadline exceeded", e.what());
+                    throw;
+                }
+            }
+
+            // guarded() for the try_ calls, a deadline that fires marks the error a timeout
+            template<class F> auto try_guarded(F f, error& e) {
+                if (deadline_ == time_point::max()) return f();
+                auto& guard = query_->deadline;
+                if (!guard.enter()) {
+                    e = error(error_kind::timeout, "query deadline exceeded", 0);
+                    return decltype(f())();
+                }
+                deadline_call call{guard};
+                auto r = f();
+                if (e && guard.fired()) e.set_kind(error_kind::timeout);
+                return r;
+            }
+
+            /*
+               stream parameter param (0 based) for the next execution from
+               source: size_t(char* buf, size_t n) returning 0 at the end
+             */
+            template<class S> statement& write_lob(int param, S source, size_t chunk_size = lob_chunk_size) {
+                data_->write_lob(param, source, chunk_size);
                 return *this;
             }
 
@@ -190,7 +474,7 @@ namespace cppstddb { namespace front {
         public:
             using database_type = D;
             using policy_type = typename database_type::policy_type;
-            using string = std::string;
+            using string = typename policy_type::string;
             using statement_t = statement<database_type>;
             using row_t = row<database_type>;
             using rowset_type = typename database_type::rowset;
@@ -205,6 +489,9 @@ namespace cppstddb { namespace front {
             shared_ptr_type data_;
             int rows_fetched_;
             int row_idx_;
+            // the query's admission slot, shared by the copies: given back when the
+            // rows are read, the statement is reset or the last copy is destroyed
+            std::shared_ptr<admission_control::permit> permit_;
 
         public:
             rowset(statement_t& statement, int row_array_size):
@@ -213,11 +500,15 @@ namespace cppstddb { namespace front {
                 row_idx_(0),
                 data_(std::make_shared<rowset_type>(*statement_.data_, row_array_size_)) {
                     //if (!stmt_.hasRows) throw new DatabaseException("not a result query");
-                    rows_fetched_ = data_->fetch();
+                    rows_fetched_ = statement_.guarded([this]{return data_->fetch();});
+                    if (!rows_fetched_) statement_.reset();
+                    else if ((permit_ = statement_.lend_permit())) permit_->served();
                 }
 
             int width() {return data_->columns;}
 
+            auto name(size_t idx) {return data_->name(idx);}
+
             // length will be for the number of rows (if defined)
             int length() {
                 //throw new Exception("not a completed/detached rowSet");
@@ -227,8 +518,27 @@ namespace cppstddb { namespace front {
             bool next() {
                 DB_TRACE("next: " << row_idx_ << ":" << rows_fetched_);
                 if (++row_idx_ == rows_fetched_) {
-                    rows_fetched_ = data_->next();
-                    if (!rows_fetched_) return false;
+                    rows_fetched_ = statement_.guarded([this]{return data_->next();});
+                    if (!rows_fetched_) {
+                        statement_.reset();
+                        return false;
+                    }
+                    row_idx_ = 0;
+                }
+                return true;
+            }
+
+            // next() returning fetch errors: true at a row, false at the end
+            result<bool> try_next() {
+                if (++row_idx_ == rows_fetched_) {
+                    error e;
+                    auto n = statement_.try_guarded([this, &e]{return data_->try_next(e);}, e);
+                    if (e) return statement_.keep_source(e);
+                    rows_fetched_ = n;
+                    if (!n) {
+                        statement_.reset();
+                        return false;
+                    }
                     row_idx_ = 0;
                 }
                 return true;
@@ -301,6 +611,13 @@ namespace cppstddb { namespace front {
     };
 
 
+    /*
+       a single pass input iterator over the live rowset: rows are read as
+       the iterator advances and *it is a row handle on the current one.
+       Iterators compare by whether they are at the end, so begin() and
+       end() also work as an iterator/sentinel pair for ranges.
+     */
+
     template<class D> class rowset_iterator {
         public:
             using database_type = D;
@@ -309,33 +626,37 @@ namespace cppstddb { namespace front {
             using row_t = row<database_type>;
 
             typedef std::ptrdiff_t difference_type;
-            typedef rowset_t value_type;
-            typedef rowset_t reference;
-            typedef rowset_t* pointer;
+            typedef row_t value_type;
+            typedef row_t reference;
+            typedef void pointer;
             typedef std::input_iterator_tag iterator_category;
+            typedef std::input_iterator_tag iterator_concept;
 
         private:
             rowset_t* rowset_;
         public:
+            rowset_iterator():rowset_(nullptr) {}
             rowset_iterator(rowset_t* rowset):rowset_(rowset) {}
-            auto operator*() {return row_t(*rowset_);}
+            row_t operator*() const {return row_t(*rowset_);}
             rowset_iterator& operator ++() {
                 rowset_->next();
                 return *this;
             }
-            bool operator==(const rowset_iterator& rhs) const {
-                return
-                    (rowset_ && !rowset_->empty()) ==
-                    (rhs.rowset_ && !rhs.rowset_->empty());
-            }
+            void operator++(int) {rowset_->next();}
+            bool at_end() const {return !rowset_ || rowset_->empty();}
+            bool operator==(const rowset_iterator& rhs) const {return at_end() == rhs.at_end();}
             bool operator!=(const rowset_iterator& rhs) const {return !operator==(rhs);}
+
+#ifdef CPPSTDDB_HAS_RANGES
+            friend bool operator==(const rowset_iterator& i, std::default_sentinel_t) {return i.at_end();}
+#endif
     };
 
     template<class D> struct cell {
         public:
             using database_type = D;
             using policy_type = typename database_type::policy_type;
-            using string = std::string;
+            using string = typename policy_type::string;
             using rowset_t = rowset<database_type>;
             using row_t = row<database_type>;
             using bind_type = typename database_type::bind_type;
@@ -349,6 +670,11 @@ namespace cppstddb { namespace front {
                 idx_(idx),
                 row_idx_(r.rows_.row_idx_) {}
 
+            cell(bind_type& b, size_t idx, int row_idx):
+                bind_(b),
+                row_idx_(row_idx),
+                idx_(idx) {}
+
             //auto bind() {return bind_;}
             //auto rowIdx() {return rowIdx_;}
     };
@@ -357,7 +683,7 @@ namespace cppstddb { namespace front {
         public:
             using database_type = D;
             using policy_type = typename database_type::policy_type;
-            using string = std::string;
+            using string = typename policy_type::string;
             using rowset_t = rowset<database_type>;
             using cell_t = cell<database_type>;
             using field_t = field<database_type>;
@@ -387,7 +713,7 @@ namespace cppstddb { namespace front {
         public:
             using database_type = D;
             using policy_type = typename database_type::policy_type;
-            using string = std::string;
+            using string = typename policy_type::string;
             using row_t = row<database_type>;
             using cell_t = cell<database_type>;
             using bind_type = typename database_type::bind_type;
@@ -403,20 +729,39 @@ namespace cppstddb { namespace front {
 
             auto type() const {return cell_.bind_.type;}
 
+            bool is_null() const {return rowset().is_null(cell_.idx_);}
+
             template<class T> T as() const {
                 return field_type<T>::as(rowset(), cell_);
             }
 
             auto str() const {return as<string>();}
 
+            // pass the value to f(const char*, size_t) in chunks, without materializing it
+            template<class F> void read_chunks(F f, size_t chunk_size = lob_chunk_size) const {
+                rowset().read_chunks(cell_.idx_, f, chunk_size);
+            }
+
+            // for types not every driver reads
+            template<class T> void print(std::ostream& os) const {
+                if constexpr (has_field_type<database_type,T>::value) print_value(os, as<T>());
+                else raise_error("unsupported type", type());
+            }
+
             friend inline std::ostream& operator<<(std::ostream &os, const field& f) {
                 //os << "hello"; // problem at -O3
                 // improve
 
                 switch(f.type()) {
                     case value_int: os << f.as<int>(); break;
+                    case value_int64: f.template print<int64_t>(os); break;
+                    case value_double: f.template print<double>(os); break;
                     case value_string: os << f.as<string>(); break;
+                    case value_blob: os << f.as<string>(); break;
                     case value_date: os << f.as<date_t>(); break;
+                    case value_decimal: os << f.as<string>(); break; // the driver's text, any precision
+                    case value_datetime: f.template print<datetime_t>(os); break;
+                    case value_time: f.template print<std::chrono::microseconds>(os); break;
                     default: raise_error("unsupported type", f.type());
                 }
                 //os << f.as<string>();
@@ -427,5 +772,12 @@ namespace cppstddb { namespace front {
 
 }}
 
+#ifdef CPPSTDDB_HAS_RANGES
+// rowsets are handles: copies share the same result, so they are cheap to pass by value into pipelines
+namespace std::ranges {
+    template<class D> inline constexpr bool enable_view<cppstddb::front::rowset<D>> = true;
+}
+#endif
+
 #endif
 
@@ -4,8 +4,16 @@
 #include <cppstddb/front.h>
 #include <cppstddb/util.h>
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <tuple>
+#include <functional>
+#include <type_traits>
+#include <charconv>
 #include <mysql/mysql.h>
 #include <cstring>
+#include <cstdio>
+#include <cctype>
 
 namespace cppstddb { namespace mysql {
 
@@ -16,7 +24,9 @@ namespace cppstddb { namespace mysql {
         template<class P> class statement;
         template<class P> class rowset;
         template<class P> class bind_type;
+        template<class P> class bind_cache;
         template<class P,class T> class field;
+        template<class P,class T> struct param;
 
         template<class P> using cell_t = cppstddb::front::cell<database<P>>;
 
@@ -39,6 +49,35 @@ namespace cppstddb { namespace mysql {
             throw database_error(msg, ret, mysql_stmt_error(stmt));
         }
 
+        template<class S> void raise_error(const S& msg, MYSQL* mysql) {
+            throw database_error(msg, mysql_errno(mysql), mysql_error(mysql));
+        }
+
+        inline error_kind error_kind_of(unsigned int code) {
+            switch(code) {
+                case 1062: // ER_DUP_ENTRY
+                case 1586: return error_kind::unique_violation; // ER_DUP_ENTRY_WITH_KEY_NAME
+                case 1213: return error_kind::serialization_failure; // ER_LOCK_DEADLOCK
+                case 1205: // ER_LOCK_WAIT_TIMEOUT
+                case 3572: return error_kind::lock_timeout; // ER_LOCK_NOWAIT
+            }
+            return error_kind::other;
+        }
+
+        // the statement's last error, the message is read when asked for
+        inline error make_error(const char* where, MYSQL_STMT* stmt) {
+            auto code = mysql_stmt_errno(stmt);
+            return error(error_kind_of(code), where, code, mysql_stmt_sqlstate(stmt),
+                    [](const void* h) {return mysql_stmt_error(static_cast<MYSQL_STMT*>(const_cast<void*>(h)));}, stmt);
+        }
+
+        // the connection's last error (direct execution)
+        inline error make_error(const char* where, MYSQL* mysql) {
+            auto code = mysql_errno(mysql);
+            return error(error_kind_of(code), where, code, mysql_sqlstate(mysql),
+                    [](const void* h) {return mysql_error(static_cast<MYSQL*>(const_cast<void*>(h)));}, mysql);
+        }
+
         template<class S> void check(const S& msg) {
             DB_TRACE(msg);
         }
@@ -64,6 +103,7 @@ namespace cppstddb { namespace mysql {
                 using rowset = rowset<policy_type>;
                 using bind_type = bind_type<policy_type>;
                 template<typename T> using field_type = field<policy_type,T>;
+                template<typename T> using param_type = param<policy_type,T>;
 
                 database() {
                     DB_TRACE("mysql client info: " << mysql_get_client_info());
@@ -74,25 +114,265 @@ namespace cppstddb { namespace mysql {
                 string date_column_type() const {return "date";}
         };
 
+        /*
+           encodes rows in the LOAD DATA default format: tab separated fields,
+           newline terminated rows, backslash escapes and \N for NULL
+         */
+
+        class infile_row {
+            public:
+                using string_view = std::experimental::string_view;
+
+                infile_row():first_(true) {}
+
+                infile_row& operator<<(std::nullptr_t) {
+                    separator();
+                    buf_.append("\\N",2);
+                    return *this;
+                }
+
+                infile_row& operator<<(const string_view& s) {
+                    separator();
+                    auto p = s.data(), e = p + s.size();
+                    while (p != e) {
+                        auto q = p;
+                        while (q != e && !special(*q)) ++q;
+                        buf_.append(p, q - p);
+                        if (q == e) break;
+                        buf_ += '\\';
+                        buf_ += *q ? (*q == '\t' ? 't' : *q == '\n' ? 'n' : '\\') : '0';
+                        p = q + 1;
+                    }
+                    return *this;
+                }
+
+                infile_row& operator<<(const std::string& s) {return *this << string_view(s);}
+                infile_row& operator<<(const char* s) {return s ? *this << string_view(s) : *this << nullptr;}
+
+                template<class T>
+                    typename std::enable_if<std::is_integral<T>::value, infile_row&>::type
+                    operator<<(T v) {
+                        separator();
+                        using wide = typename std::conditional<
+                            std::is_signed<T>::value, long long, unsigned long long>::type;
+                        char b[24];
+                        auto r = std::to_chars(b, b + sizeof(b), static_cast<wide>(v));
+                        buf_.append(b, r.ptr - b);
+                        return *this;
+                    }
+
+                // shortest form that reads back the same
+                infile_row& operator<<(double v) {
+                    separator();
+                    char b[32];
+                    auto r = std::to_chars(b, b + sizeof(b), v);
+                    buf_.append(b, r.ptr - b);
+                    return *this;
+                }
+
+                // YYYY-MM-DD
+                infile_row& operator<<(const date_t& d) {
+                    separator();
+                    char b[16];
+                    auto r = std::to_chars(b, b + 8, d.year());
+                    auto p = r.ptr;
+                    for(int v : {d.month(), d.day()}) {
+                        *p++ = '-';
+                        *p++ = static_cast<char>('0' + v / 10 % 10);
+                        *p++ = static_cast<char>('0' + v % 10);
+                    }
+                    buf_.append(b, p - b);
+                    return *this;
+                }
+
+                template<class... T> infile_row& operator<<(const std::tuple<T...>& t) {
+                    append_tuple(t, std::index_sequence_for<T...>());
+                    return *this;
+                }
+
+                template<class A, class B> infile_row& operator<<(const std::pair<A,B>& p) {
+                    return *this << p.first << p.second;
+                }
+
+                // row framing, used by infile_source
+                size_t begin() {first_ = true; return buf_.size();}
+                void end() {buf_ += '\n';}
+                void rollback(size_t mark) {buf_.resize(mark);}
+
+                std::string& buffer() {return buf_;}
+
+            private:
+                std::string buf_;
+                bool first_;
+
+                static bool special(char c) {
+                    return c == '\\' || c == '\t' || c == '\n' || c == 0;
+                }
+
+                void separator() {
+                    if (!first_) buf_ += '\t';
+                    first_ = false;
+                }
+
+                template<class T, size_t... I>
+                    void append_tuple(const T& t, std::index_sequence<I...>) {
+                        (void) std::initializer_list<int>{((*this << std::get<I>(t)), 0)...};
+                    }
+        };
+
+        struct infile_source {
+            using producer = std::function<bool(infile_row&)>;
+            producer produce;
+            infile_row row;
+            size_t pos;
+            bool done;
+            std::string error_message;
+
+            infile_source(producer p):produce(p),pos(0),done(false) {}
+
+            // fill buf with up to n bytes of encoded rows, 0 at end of data
+            int read(char* buf, unsigned int n) {
+                auto& b = row.buffer();
+                while (b.size() - pos < n && !done) {
+                    auto mark = row.begin();
+                    if (produce(row)) {
+                        row.end();
+                    } else {
+                        row.rollback(mark);
+                        done = true;
+                    }
+                }
+                size_t k = std::min<size_t>(n, b.size() - pos);
+                memcpy(buf, b.data() + pos, k);
+                pos += k;
+                if (pos == b.size()) {
+                    b.clear();
+                    pos = 0;
+                } else if (pos > b.size() / 2) {
+                    b.erase(0, pos);
+                    pos = 0;
+                }
+                return k;
+            }
+
+            // no source (outside load_data): the server asked for a file, refuse
+            static int init(void** ptr, const char* filename, void* userdata) {
+                *ptr = userdata;
+                return userdata ? 0 : 1;
+            }
+
+            static int read(void* ptr, char* buf, unsigned int buf_len) {
+                auto& s = *static_cast<infile_source*>(ptr);
+                try {
+                    return s.read(buf, buf_len);
+                } catch (std::exception& e) {
+                    s.error_message = e.what();
+                    return -1;
+                }
+            }
+
+            static void end(void* ptr) {}
+
+            static int error(void* ptr, char* error_msg, unsigned int error_msg_len) {
+                static const std::string refused = "local infile is only read by load_data";
+                auto& m = ptr ? static_cast<infile_source*>(ptr)->error_message : refused;
+                auto n = std::min<size_t>(m.size(), error_msg_len - 1);
+                memcpy(error_msg, m.data(), n);
+                error_msg[n] = 0;
+                return CR_UNKNOWN_ERROR;
+            }
+
+            // route LOAD DATA LOCAL to source, or refuse it when null
+            static void install(MYSQL* mysql, infile_source* source) {
+                mysql_set_local_infile_handler(mysql, init, read, end, error, source);
+            }
+        };
+
+        template<class R> auto infile_producer(R& rows, std::true_type) {
+            return infile_source::producer(std::ref(rows));
+        }
+
+        template<class R> auto infile_producer(R& rows, std::false_type) {
+            auto i = std::begin(rows);
+            auto e = std::end(rows);
+            return infile_source::producer([i,e](infile_row& row) mutable {
+                    if (i == e) return false;
+                    row << *i;
+                    ++i;
+                    return true;
+                    });
+        }
+
         template<class P> class connection {
             public:
                 using policy_type = P;
+                using string = typename policy_type::string;
                 using database = database<policy_type>;
                 MYSQL *mysql;
+                source src;
+                unsigned long thread_id;
+                unsigned long prefetch_rows; // 0: plain unbuffered fetch
             public:
                 database& db;
 
-                connection(database& db_, const source& src):db(db_) {
+                connection(database& db_, const source& src_):db(db_),src(src_) {
                     DB_TRACE("con");
+                    prefetch_rows = src.option_int("prefetch_rows", 0);
                     mysql = check("mysql_init", mysql_init(nullptr));
+                    connect(mysql, src);
+                    thread_id = mysql_thread_id(mysql);
+                }
+
+                ~connection() {
+                    DB_TRACE("~con");
+                    if (mysql) mysql_close(mysql);
+                }
+
+                /*
+                   uri options: port (or host:port), socket, connect_timeout,
+                   read_timeout and write_timeout (seconds), compress,
+                   prefetch_rows which fetches results through a read only
+                   server cursor that many rows at a time, and local_infile
+                   which allows load_data (negotiated when connecting)
+                 */
+
+                static void connect(MYSQL* mysql, const source& src) {
+                    unsigned int port = src.port;
+                    std::string host = src.server;
+                    auto colon = host.rfind(':');
+                    if (!port && colon != std::string::npos && host.find(':') == colon) {
+                        port = source::parse_int("port", host.substr(colon + 1));
+                        host.erase(colon);
+                    }
 
-                    int port = 0;
-                    const char *unix_socket = nullptr;
+                    std::string socket = src.option("socket");
+                    const char *unix_socket = socket.empty() ? nullptr : socket.c_str();
                     unsigned long clientflag = 0L;
 
+                    for(auto& o : src.options) {
+                        auto& key = o.first;
+                        if (key == "connect_timeout" || key == "read_timeout" || key == "write_timeout") {
+                            unsigned int seconds = src.option_int(key, 0);
+                            auto option =
+                                key == "connect_timeout" ? MYSQL_OPT_CONNECT_TIMEOUT :
+                                key == "read_timeout" ? MYSQL_OPT_READ_TIMEOUT :
+                                MYSQL_OPT_WRITE_TIMEOUT;
+                            mysql_options(mysql, option, &seconds);
+                        } else if (key == "compress") {
+                            if (src.option_bool(key, false)) mysql_options(mysql, MYSQL_OPT_COMPRESS, nullptr);
+                        } else if (key == "local_infile") {
+                            unsigned int local_infile = src.option_bool(key, false);
+                            mysql_options(mysql, MYSQL_OPT_LOCAL_INFILE, &local_infile);
+                            // files are only sent from load_data, never read from disk
+                            if (local_infile) infile_source::install(mysql, nullptr);
+                        } else if (key != "socket" && key != "prefetch_rows") {
+                            DB_WARN("mysql: ignoring option " << key);
+                        }
+                    }
+
                     check("mysql_real_connect", mysql_real_connect(
                                 mysql,
-                                src.server.c_str(),
+                                host.c_str(),
                                 src.username.c_str(),
                                 src.password.c_str(),
                                 src.database.c_str(),
@@ -101,9 +381,56 @@ namespace cppstddb { namespace mysql {
                                 clientflag));
                 }
 
-                ~connection() {
-                    DB_TRACE("~con");
-                    if (mysql) mysql_close(mysql);
+                // KILL QUERY over a side connection (this one is busy), thread safe
+                void cancel() {
+                    DB_TRACE("con: cancel: thread id: " << thread_id);
+                    MYSQL* side = check("mysql_init", mysql_init(nullptr));
+                    try {
+                        connect(side, src);
+                        auto sql = "kill query " + std::to_string(thread_id);
+                        if (mysql_real_query(side, sql.c_str(), sql.size())) raise_error("kill query", side);
+                    } catch (...) {
+                        mysql_close(side);
+                        throw;
+                    }
+                    mysql_close(side);
+                }
+
+                void begin() {
+                    if (mysql_real_query(mysql, "start transaction", 17)) raise_error("start transaction", mysql);
+                }
+
+                void commit() {
+                    if (mysql_commit(mysql)) raise_error("mysql_commit", mysql);
+                }
+
+                void rollback() {
+                    if (mysql_rollback(mysql)) raise_error("mysql_rollback", mysql);
+                }
+
+                /*
+                   bulk load rows with LOAD DATA LOCAL INFILE, encoding them on
+                   the fly from a container (of values, tuples or pairs) or from
+                   a generator bool(infile_row&) that returns false when done.
+                   table may include a column list: "score (name,score,d)".
+                   Needs the local_infile uri option.
+                 */
+
+                template<class R> unsigned long long load_data(const string& table, R&& rows) {
+                    using is_generator = std::is_constructible<infile_source::producer, R&>;
+                    infile_source src(infile_producer(rows, is_generator()));
+
+                    string sql;
+                    sql += "load data local infile 'cppstddb_stream' into table ";
+                    sql += table;
+                    DB_TRACE("load_data: " << sql);
+
+                    infile_source::install(mysql, &src);
+                    int ret = mysql_real_query(mysql, sql.c_str(), sql.size());
+                    infile_source::install(mysql, nullptr); // src is going away
+
+                    if (ret) raise_error("load_data", mysql);
+                    return mysql_affected_rows(mysql);
                 }
 
         };
@@ -114,35 +441,143 @@ namespace cppstddb { namespace mysql {
                 using string = typename policy_type::string;
                 using connection = connection<policy_type>;
                 using rowset = rowset<policy_type>;
+                MYSQL *mysql;
                 MYSQL_STMT *stmt;
                 string sql;
                 int binds;
+                bind_cache<policy_type> cache; // result binds reused across executions
+                typename policy_type::template vector<MYSQL_BIND> params;
+                bool params_changed; // bound with mysql_stmt_bind_param on the next query
+                bool direct;
+                MYSQL_RES *direct_result; // unbuffered, rows are read as they are fetched
             public:
-                statement(connection& con, const string& sql_):sql(sql_),binds(0) {
+                statement(connection& con, const string& sql_):
+                    mysql(con.mysql),
+                    sql(sql_, policy_type::template get_allocator<char>()),
+                    binds(0),
+                    params(policy_type::template get_allocator<MYSQL_BIND>()),
+                    params_changed(false),
+                    direct(false),
+                    direct_result(nullptr) {
                     DB_TRACE("stmt: " << sql);
                     stmt = check("mysql_stmt_init", mysql_stmt_init(con.mysql));
+                    if (con.prefetch_rows) {
+                        unsigned long cursor = CURSOR_TYPE_READ_ONLY;
+                        mysql_stmt_attr_set(stmt, STMT_ATTR_CURSOR_TYPE, &cursor);
+                        mysql_stmt_attr_set(stmt, STMT_ATTR_PREFETCH_ROWS, &con.prefetch_rows);
+                    }
                 }
 
                 ~statement() {
                     DB_TRACE("~stmt");
+                    free_result();
                     if (stmt) mysql_stmt_close(stmt);
                 }
 
                 void prepare() {
                     DB_TRACE("prepare sql: " << sql);
+                    cache.clear();
+                    direct = false;
                     check("mysql_stmt_prepare", stmt, mysql_stmt_prepare(
                                 stmt,
                                 sql.c_str(),
                                 sql.size()));
 
                     binds = mysql_stmt_param_count(stmt);
+                    params.clear();
+                    params_changed = false;
+                }
+
+                /*
+                   execute-direct, for sql without parameters: no server side
+                   statement, each query is one mysql_real_query and the rows
+                   come back in the text protocol (mysql_use_result)
+                 */
+                void prepare_direct() {
+                    DB_TRACE("direct sql: " << sql);
+                    cache.clear();
+                    binds = 0;
+                    params.clear();
+                    params_changed = false;
+                    direct = true;
+                }
+
+                // all parameters null until bound
+                void begin_bind() {
+                    params.assign(binds, MYSQL_BIND());
+                    for(auto&& p : params) p.buffer_type = MYSQL_TYPE_NULL;
+                    params_changed = true;
+                }
+
+                // the value is referenced, not copied, and must live until query()
+                void bind_param(int idx, enum_field_types type, const void* p, unsigned long n, bool is_unsigned = false) {
+                    if (idx < 0 || static_cast<size_t>(idx) >= params.size()) raise_error("bind_param: no such parameter", idx);
+                    auto& b = params[idx];
+                    b.buffer_type = type;
+                    b.buffer = const_cast<void*>(p);
+                    b.buffer_length = n;
+                    b.is_unsigned = is_unsigned;
+                }
+
+                /*
+                   stream a parameter with mysql_stmt_send_long_data, once per
+                   execution; parameters not streamed are null
+                 */
+                template<class S> void write_lob(int param, S source, size_t chunk) {
+                    if (param < 0 || param >= binds) raise_error("write_lob: no such parameter", param);
+                    if (params.empty()) begin_bind();
+                    if (params_changed || params[param].buffer_type != MYSQL_TYPE_LONG_BLOB) {
+                        params[param].buffer_type = MYSQL_TYPE_LONG_BLOB;
+                        check("mysql_stmt_bind_param", stmt, mysql_stmt_bind_param(stmt, &params[0]));
+                        params_changed = false;
+                    }
+
+                    typename policy_type::template vector<char> buf(chunk, policy_type::template get_allocator<char>());
+                    while (auto n = source(buf.data(), buf.size())) {
+                        check("mysql_stmt_send_long_data", stmt,
+                                mysql_stmt_send_long_data(stmt, param, buf.data(), n));
+                    }
                 }
 
                 statement& query() {
-                    check("mysql_stmt_execute", stmt, mysql_stmt_execute(stmt));
+                    error e;
+                    if (!try_query(e)) e.raise();
                     return *this;
                 }
 
+                bool try_query(error& e) {
+                    if (direct) return try_query_direct(e);
+                    if (params_changed && !params.empty() && mysql_stmt_bind_param(stmt, &params[0])) {
+                        e = make_error("mysql_stmt_bind_param", stmt);
+                        return false;
+                    }
+                    params_changed = false;
+                    if (mysql_stmt_execute(stmt)) {
+                        e = make_error("mysql_stmt_execute", stmt);
+                        return false;
+                    }
+                    return true;
+                }
+
+                bool try_query_direct(error& e) {
+                    free_result(); // unread rows of the last execution
+                    if (mysql_real_query(mysql, sql.c_str(), sql.size())) {
+                        e = make_error("mysql_real_query", mysql);
+                        return false;
+                    }
+                    direct_result = mysql_use_result(mysql);
+                    if (!direct_result && mysql_field_count(mysql)) {
+                        e = make_error("mysql_use_result", mysql);
+                        return false;
+                    }
+                    return true;
+                }
+
+                void free_result() {
+                    if (direct_result) mysql_free_result(direct_result);
+                    direct_result = nullptr;
+                }
+
         };
 
         template<class P> struct describe_type {
@@ -153,14 +588,19 @@ namespace cppstddb { namespace mysql {
             MYSQL_FIELD *field;
         };
 
+        // initial string/blob bind size, longer values are fetched when used
+        const unsigned long max_string_bind = 4096;
+
         template<class P> struct bind_type {
             value_type type;
             int mysql_type;
             int alloc_size;
             void* data;
+            void* value; // data, the column overflow buffer, or null while a truncated value is unfetched
             unsigned long length; // check type
             my_bool is_null;
             my_bool error;
+            my_bool is_unsigned;
         };
 
         template<class P> struct bind_context {
@@ -190,115 +630,356 @@ namespace cppstddb { namespace mysql {
                 }
             }
 
-            /*
-            std::stringstream s;
-            s << "binder: type not found: " << ctx.describe.field->type;
-            throw database_error(s.str());
-            */
-
-            DB_WARN("type not found, binding to string for now: " << type);
+            DB_TRACE("type not found, binding to string: " << type);
             bind_string(ctx);
         }
 
+        /*
+           results bind to fixed size native buffers where the server can
+           convert (integers, floating point, temporal types), text and binary
+           types bind to a buffer that overflows for long values
+         */
+
         template<class P> void bind_long(bind_context<P>& ctx) {
-            ctx.bind.mysql_type = ctx.describe.field->type;
+            auto& f = *ctx.describe.field;
+            if (f.type == MYSQL_TYPE_LONG && (f.flags & UNSIGNED_FLAG)) {
+                bind_longlong(ctx); // may not fit an int
+                return;
+            }
+            ctx.bind.mysql_type = MYSQL_TYPE_LONG;
             ctx.bind.type = value_int;
-            ctx.bind.alloc_size = ctx.describe.field->length; // ???
+            ctx.bind.alloc_size = sizeof(int);
+        }
+
+        template<class P> void bind_longlong(bind_context<P>& ctx) {
+            ctx.bind.mysql_type = MYSQL_TYPE_LONGLONG;
+            ctx.bind.type = value_int64;
+            ctx.bind.alloc_size = sizeof(int64_t);
+            ctx.bind.is_unsigned = (ctx.describe.field->flags & UNSIGNED_FLAG) != 0;
+        }
+
+        template<class P> void bind_bit(bind_context<P>& ctx) {
+            // up to 64 bits, big endian bytes
+            ctx.bind.mysql_type = MYSQL_TYPE_BIT;
+            ctx.bind.type = value_int64;
+            ctx.bind.alloc_size = sizeof(uint64_t);
+        }
+
+        template<class P> void bind_double(bind_context<P>& ctx) {
+            ctx.bind.mysql_type = MYSQL_TYPE_DOUBLE;
+            ctx.bind.type = value_double;
+            ctx.bind.alloc_size = sizeof(double);
+        }
+
+        template<class P> void bind_decimal(bind_context<P>& ctx) {
+            // text form, precision digits plus sign and point
+            ctx.bind.mysql_type = MYSQL_TYPE_STRING;
+            ctx.bind.type = value_decimal;
+            ctx.bind.alloc_size = ctx.describe.field->length + 3;
         }
 
         template<class P> void bind_date(bind_context<P>& ctx) {
-            ctx.bind.mysql_type = ctx.describe.field->type;
+            ctx.bind.mysql_type = MYSQL_TYPE_DATE;
             ctx.bind.type = value_date;
             ctx.bind.alloc_size = sizeof(MYSQL_TIME);
         }
 
+        template<class P> void bind_datetime(bind_context<P>& ctx) {
+            ctx.bind.mysql_type = MYSQL_TYPE_DATETIME;
+            ctx.bind.type = value_datetime;
+            ctx.bind.alloc_size = sizeof(MYSQL_TIME);
+        }
+
+        template<class P> void bind_time(bind_context<P>& ctx) {
+            ctx.bind.mysql_type = MYSQL_TYPE_TIME;
+            ctx.bind.type = value_time;
+            ctx.bind.alloc_size = sizeof(MYSQL_TIME);
+        }
+
         template<class P> void bind_string(bind_context<P>& ctx) {
-            ctx.bind.mysql_type = ctx.describe.field->type;
-            ctx.bind.type = value_string;
-            ctx.bind.alloc_size = ctx.describe.field->length + 1;
+            // binary charset: blob and binary columns
+            const unsigned int binary_charset = 63;
+            auto& f = *ctx.describe.field;
+            ctx.bind.mysql_type = MYSQL_TYPE_STRING;
+            ctx.bind.type = f.charsetnr == binary_charset ? value_blob : value_string;
+            ctx.bind.alloc_size = std::min<unsigned long>(f.length, max_string_bind - 1) + 1;
         }
 
         template<class P> const bind_info<P> bind_info<P>::info[] = {
             {MYSQL_TYPE_TINY, bind_long<P>},
             {MYSQL_TYPE_SHORT, bind_long<P>},
+            {MYSQL_TYPE_INT24, bind_long<P>},
             {MYSQL_TYPE_LONG, bind_long<P>},
-            {MYSQL_TYPE_LONGLONG, bind_long<P>},
+            {MYSQL_TYPE_YEAR, bind_long<P>},
+            {MYSQL_TYPE_LONGLONG, bind_longlong<P>},
+            {MYSQL_TYPE_BIT, bind_bit<P>},
+            {MYSQL_TYPE_FLOAT, bind_double<P>},
+            {MYSQL_TYPE_DOUBLE, bind_double<P>},
+            {MYSQL_TYPE_DECIMAL, bind_decimal<P>},
+            {MYSQL_TYPE_NEWDECIMAL, bind_decimal<P>},
             {MYSQL_TYPE_DATE, bind_date<P>},
-            // MYSQL_TYPE_DATETIME
+            {MYSQL_TYPE_NEWDATE, bind_date<P>},
+            {MYSQL_TYPE_DATETIME, bind_datetime<P>},
+            {MYSQL_TYPE_TIMESTAMP, bind_datetime<P>},
+            {MYSQL_TYPE_TIME, bind_time<P>},
             {MYSQL_TYPE_STRING, bind_string<P>},
+            {MYSQL_TYPE_VAR_STRING, bind_string<P>},
+            {MYSQL_TYPE_VARCHAR, bind_string<P>},
+            {MYSQL_TYPE_ENUM, bind_string<P>},
+            {MYSQL_TYPE_SET, bind_string<P>},
+            {MYSQL_TYPE_JSON, bind_string<P>},
+            {MYSQL_TYPE_TINY_BLOB, bind_string<P>},
+            {MYSQL_TYPE_MEDIUM_BLOB, bind_string<P>},
+            {MYSQL_TYPE_LONG_BLOB, bind_string<P>},
+            {MYSQL_TYPE_BLOB, bind_string<P>},
+            {MYSQL_TYPE_GEOMETRY, bind_string<P>},
             {0,nullptr}
         };
 
+        /*
+           bump allocator for rowset bind buffers: one block sized for all
+           columns, kept by the statement and reused across executions
+         */
+
+        class bind_arena {
+            public:
+                static const size_t alignment = 8;
+
+                bind_arena():data_(nullptr),size_(0),used_(0) {}
+                ~bind_arena() {free(data_);}
+
+                bind_arena(const bind_arena&) = delete;
+                bind_arena& operator=(const bind_arena&) = delete;
+
+                static size_t align(size_t n) {return (n + alignment - 1) & ~(alignment - 1);}
+
+                // start over with room for at least n bytes (only allocates to grow)
+                void reset(size_t n) {
+                    if (n > size_) {
+                        free(data_);
+                        data_ = static_cast<char*>(malloc(n));
+                        if (!data_) {
+                            size_ = 0;
+                            throw std::bad_alloc();
+                        }
+                        size_ = n;
+                    }
+                    used_ = 0;
+                }
+
+                void* allocate(size_t n) {
+                    n = align(n);
+                    if (size_ - used_ < n) throw std::bad_alloc();
+                    auto p = data_ + used_;
+                    used_ += n;
+                    return p;
+                }
+
+                size_t size() const {return size_;}
+
+            private:
+                char* data_;
+                size_t size_;
+                size_t used_;
+        };
+
+        template<class P> struct bind_cache {
+            using describe_type = describe_type<P>;
+            using bind_type = bind_type<P>;
+
+            MYSQL_RES *result_metadata;
+            unsigned int columns;
+            typename P::template vector<describe_type> describes;
+            typename P::template vector<bind_type> binds;
+            typename P::template vector<MYSQL_BIND> mysql_binds;
+            bind_arena allocator;
+
+            // per column, values that did not fit their bind buffer (current row only)
+            typename P::template vector<typename P::template vector<char>> overflow;
+
+            bind_cache():
+                result_metadata(nullptr),
+                columns(0),
+                describes(P::template get_allocator<describe_type>()),
+                binds(P::template get_allocator<bind_type>()),
+                mysql_binds(P::template get_allocator<MYSQL_BIND>()),
+                overflow(P::template get_allocator<typename P::template vector<char>>()) {}
+            ~bind_cache() {clear();}
+
+            bool built() const {return result_metadata != nullptr;}
+
+            void clear() {
+                if (result_metadata) {
+                    check("mysql_free_result");
+                    mysql_free_result(result_metadata);
+                    result_metadata = nullptr;
+                }
+                columns = 0;
+                describes.clear();
+                binds.clear();
+                mysql_binds.clear();
+                overflow.clear();
+            }
+        };
+
+        // "YYYY-MM-DD", "YYYY-MM-DD hh:mm:ss[.ffffff]" or "[-]hhh:mm:ss[.ffffff]"
+        inline void parse_time(MYSQL_TIME& t, const char* p, int mysql_type) {
+            memset(&t, 0, sizeof(t));
+            if (mysql_type == MYSQL_TYPE_TIME) {
+                if (*p == '-') {
+                    t.neg = 1;
+                    ++p;
+                }
+                sscanf(p, "%u:%u:%u", &t.hour, &t.minute, &t.second);
+                t.time_type = MYSQL_TIMESTAMP_TIME;
+            } else {
+                sscanf(p, "%u-%u-%u %u:%u:%u", &t.year, &t.month, &t.day, &t.hour, &t.minute, &t.second);
+                t.time_type = mysql_type == MYSQL_TYPE_DATE ? MYSQL_TIMESTAMP_DATE : MYSQL_TIMESTAMP_DATETIME;
+            }
+            if (auto f = strchr(p, '.')) {
+                unsigned long scale = 100000;
+                for(++f; isdigit(*f) && scale; ++f, scale /= 10) t.second_part += (*f - '0') * scale;
+            }
+        }
+
+        /*
+           a text protocol value (null terminated, n long) into its result
+           bind: numbers and temporals are parsed into the bind buffer, text,
+           binary and decimal values are used where they are in the row
+         */
+        template<class P> void from_text(bind_type<P>& b, char* p, unsigned long n) {
+            b.value = b.data;
+            switch(b.mysql_type) {
+                case MYSQL_TYPE_LONG: {
+                                          int v = 0;
+                                          std::from_chars(p, p + n, v);
+                                          *static_cast<int*>(b.data) = v;
+                                          return;
+                                      }
+                case MYSQL_TYPE_LONGLONG: {
+                                              int64_t v = 0;
+                                              if (b.is_unsigned) {
+                                                  uint64_t u = 0;
+                                                  std::from_chars(p, p + n, u);
+                                                  v = static_cast<int64_t>(u);
+                                              } else {
+                                                  std::from_chars(p, p + n, v);
+                                              }
+                                              *static_cast<int64_t*>(b.data) = v;
+                                              return;
+                                          }
+                case MYSQL_TYPE_BIT:
+                                          b.length = std::min<unsigned long>(n, sizeof(uint64_t));
+                                          memcpy(b.data, p, b.length);
+                                          return;
+                case MYSQL_TYPE_DOUBLE:
+                                          *static_cast<double*>(b.data) = strtod(p, nullptr);
+                                          return;
+                case MYSQL_TYPE_DATE:
+                case MYSQL_TYPE_DATETIME:
+                case MYSQL_TYPE_TIME:
+                                          parse_time(*static_cast<MYSQL_TIME*>(b.data), p, b.mysql_type);
+                                          return;
+            }
+            b.value = p;
+        }
+
         template<class P> class rowset {
             public:
                 using policy_type = P;
+                using string = typename policy_type::string;
                 using cell_t = cell_t<policy_type>;
                 using statement = statement<policy_type>;
                 using bind_type = bind_type<policy_type>;
                 using bind_context = bind_context<policy_type>;
+                using bind_cache = bind_cache<policy_type>;
                 statement& stmt;
-                //Allocator *allocator;
+                bind_cache& cache;
+                bind_arena& allocator;
                 unsigned int columns;
 
                 MYSQL_RES *result_metadata;
                 int status;
 
                 using describe_type = describe_type<policy_type>;
-                using describe_vector = std::vector<describe_type>;
-                using bind_vector = std::vector<bind_type>;
-                using mysql_bind_vector = std::vector<MYSQL_BIND>;
+                using describe_vector = typename policy_type::template vector<describe_type>;
+                using bind_vector = typename policy_type::template vector<bind_type>;
+                using mysql_bind_vector = typename policy_type::template vector<MYSQL_BIND>;
 
-                describe_vector describes;
-                bind_vector binds;
-                mysql_bind_vector mysql_binds;
+                // owned by the statement, built on first execution
+                describe_vector& describes;
+                bind_vector& binds;
+                mysql_bind_vector& mysql_binds;
+                typename policy_type::template vector<typename policy_type::template vector<char>>& overflow;
+                bool overflowed;
 
                 //static const maxData = 256;
 
             public:
                 rowset(statement& stmt_, int rowArraySize_):
-                    stmt(stmt_) {
-                        //allocator = stmt.allocator;
-
-                        result_metadata =
-                            check("mysql_stmt_result_metadata",
-                                    mysql_stmt_result_metadata(stmt.stmt));
-
-                        if (!result_metadata) return; // check this
-                        columns = mysql_num_fields(result_metadata);
-                        DB_TRACE("columns: " << columns);
-
-                        build_describe();
-                        build_bind();
+                    stmt(stmt_),
+                    cache(stmt_.cache),
+                    allocator(cache.allocator),
+                    columns(0),
+                    result_metadata(nullptr),
+                    describes(cache.describes),
+                    binds(cache.binds),
+                    mysql_binds(cache.mysql_binds),
+                    overflow(cache.overflow),
+                    overflowed(false) {
+
+                        if (stmt.direct) {
+                            // a new result each execution, binds are rebuilt for it
+                            result_metadata = stmt.direct_result;
+                            if (!result_metadata) return;
+                            describes.clear();
+                            binds.clear();
+                            columns = mysql_num_fields(result_metadata);
+                            build_describe();
+                            build_bind();
+                            return;
+                        }
+
+                        if (!cache.built()) {
+                            cache.result_metadata =
+                                check("mysql_stmt_result_metadata",
+                                        mysql_stmt_result_metadata(stmt.stmt));
+
+                            result_metadata = cache.result_metadata;
+                            if (!result_metadata) return; // check this
+                            columns = mysql_num_fields(result_metadata);
+                            DB_TRACE("columns: " << columns);
+
+                            build_describe();
+                            build_bind();
+                            cache.columns = columns;
+                        } else {
+                            DB_TRACE("rowset: reusing binds");
+                            result_metadata = cache.result_metadata;
+                            columns = cache.columns;
+                            for(auto&& b : binds) b.value = b.data;
+                        }
+
+                        if (columns) mysql_stmt_bind_result(stmt.stmt, &mysql_binds[0]);
                     }
 
                 ~rowset() {
                     DB_TRACE("~rowset");
-
-                    //foreach(b; bind) allocator.deallocate(b.data);
-
-                    for(auto&& b : binds) {
-                        //DB_TRACE("free: " << ", data: " << b.data << ", size: " << b.alloc_size);
-                        free(b.data);
-                    }
-
-                    if (result_metadata) {
-                        check("mysql_free_result");
-                        mysql_free_result(result_metadata);
-                    }
+                    // bind buffers and metadata stay with the statement
                 }
 
                 void build_describe() {
-                    columns = mysql_stmt_field_count(stmt.stmt);
-
                     describes.reserve(columns);
 
                     for(int i = 0; i != columns; ++i) {
-                        describes.push_back(describe_type());
-                        auto& d = describes.back();
+                        auto field = check("mysql_fetch_field", mysql_fetch_field(result_metadata));
 
-                        d.index = i;
-                        d.field = check("mysql_fetch_field", mysql_fetch_field(result_metadata));
-                        d.name = d.field->name;
+                        // name built with the policy allocator, then moved in
+                        describes.push_back(describe_type{
+                                i,
+                                make_string<policy_type,string>(field->name, strlen(field->name)),
+                                field});
+                        auto& d = describes.back();
 
                         //DB_TRACE("describe: name: ", d.name, ", mysql type: ", d.field.type);
                         DB_TRACE("describe: name: " << d.name);
@@ -309,6 +990,7 @@ namespace cppstddb { namespace mysql {
 
                     binds.reserve(columns);
 
+                    size_t total = 0;
                     for(int i = 0; i != columns; ++i) {
                         auto& d = describes[i];
                         binds.push_back(bind_type());
@@ -316,15 +998,18 @@ namespace cppstddb { namespace mysql {
 
                         bind_context ctx(d,b);
                         binder(ctx);
+                        total += bind_arena::align(b.alloc_size);
+                    }
 
-                        //b.data = allocator.allocate(b.alloc_size);
-
-                        b.data = malloc(b.alloc_size);
-                        //DB_TRACE("malloc: " << i << ", data: " << b.data << ", size: " << b.alloc_size);
+                    // one allocation for all column buffers
+                    allocator.reset(total);
+                    for(auto&& b : binds) {
+                        b.data = allocator.allocate(b.alloc_size);
+                        b.value = b.data;
+                        //DB_TRACE("allocate: " << ", data: " << b.data << ", size: " << b.alloc_size);
                     }
 
                     setup(binds, mysql_binds);
-                    my_bool result = mysql_stmt_bind_result(stmt.stmt, &mysql_binds[0]);
                 }
 
 
@@ -341,6 +1026,7 @@ namespace cppstddb { namespace mysql {
                         mb.length = &b.length;
                         mb.is_null = &b.is_null;
                         mb.error = &b.error;
+                        mb.is_unsigned = b.is_unsigned;
                     }
                 }
 
@@ -351,22 +1037,114 @@ namespace cppstddb { namespace mysql {
                 }
 
                 int next() {
-                    status = check("mysql_stmt_fetch", stmt.stmt, mysql_stmt_fetch(stmt.stmt));
+                    error e;
+                    int n = try_next(e);
+                    if (e) e.raise();
+                    return n;
+                }
+
+                int try_next(error& e) {
+                    if (stmt.direct) return try_next_direct(e);
+                    if (overflowed) {
+                        for(auto&& b : binds) b.value = b.data;
+                        overflowed = false;
+                    }
+
+                    status = mysql_stmt_fetch(stmt.stmt);
+                    DB_TRACE("mysql_stmt_fetch:" << status);
                     if (!status) {
                         return 1;
                     } else if (status == MYSQL_NO_DATA) {
-                        //rows_ = row_count_;
                         return 0;
                     } else if (status == MYSQL_DATA_TRUNCATED) {
-                        raise_error("mysql_stmt_fetch: truncation", status);
+                        truncated();
+                        return 1;
                     }
 
-                    raise_error("mysql_stmt_fetch", stmt.stmt, status);
+                    e = make_error("mysql_stmt_fetch", stmt.stmt);
                     return 0;
                 }
 
+                // values point into the row, valid until the next fetch
+                int try_next_direct(error& e) {
+                    if (!result_metadata) return 0;
+                    MYSQL_ROW row = mysql_fetch_row(result_metadata);
+                    if (!row) {
+                        if (mysql_errno(stmt.mysql)) e = make_error("mysql_fetch_row", stmt.mysql);
+                        return 0;
+                    }
+                    auto lengths = mysql_fetch_lengths(result_metadata);
+                    for(unsigned int i = 0; i != columns; ++i) {
+                        auto& b = binds[i];
+                        b.is_null = row[i] == nullptr;
+                        b.length = lengths[i];
+                        if (!b.is_null) from_text<policy_type>(b, row[i], b.length);
+                    }
+                    return 1;
+                }
+
+                /*
+                   values longer than their bind buffer are only fetched when
+                   used: whole by value(), or in chunks by read_chunks()
+                 */
+
+                void truncated() {
+                    for(auto&& b : binds) {
+                        if (!b.error) continue;
+                        if (b.type != value_string && b.type != value_blob) {
+                            raise_error("mysql_stmt_fetch: truncation", status);
+                        }
+                        b.value = nullptr;
+                    }
+                    overflowed = true;
+                }
+
+                const char* value(bind_type& b) const {
+                    if (b.value) return static_cast<const char*>(b.value);
+                    auto col = &b - &binds[0];
+                    DB_TRACE("overflow: column: " << col << ", length: " << b.length);
+                    if (overflow.size() < columns) overflow.resize(columns);
+                    auto& buf = overflow[col];
+                    if (buf.size() < b.length + 1) buf.resize(b.length + 1);
+                    fetch_column(col, buf.data(), b.length, 0);
+                    buf[b.length] = 0;
+                    b.value = buf.data();
+                    return buf.data();
+                }
+
+                void fetch_column(int col, char* p, unsigned long n, unsigned long offset) const {
+                    MYSQL_BIND mb = mysql_binds[col];
+                    mb.buffer = p;
+                    mb.buffer_length = n;
+                    mb.length = nullptr;
+                    mb.error = nullptr;
+                    check("mysql_stmt_fetch_column", stmt.stmt,
+                            mysql_stmt_fetch_column(stmt.stmt, &mb, col, offset));
+                }
+
+                template<class F> void read_chunks(int col, F f, size_t chunk) const {
+                    auto& b = binds[col];
+                    if (b.is_null) return;
+                    if (b.value) {
+                        auto p = static_cast<const char*>(b.value);
+                        for(size_t i = 0; i < b.length; i += chunk) f(p + i, std::min<size_t>(chunk, b.length - i));
+                        return;
+                    }
+                    typename policy_type::template vector<char> buf(
+                            std::min<size_t>(chunk, b.length),
+                            policy_type::template get_allocator<char>());
+                    for(size_t i = 0; i < b.length; i += chunk) {
+                        auto n = std::min<size_t>(chunk, b.length - i);
+                        fetch_column(col, buf.data(), n, i);
+                        f(static_cast<const char*>(buf.data()), n);
+                    }
+                }
+
+                bool is_null(int col) const {return binds[col].is_null;}
+
                 auto name(size_t idx) {
-                    return describes[idx].name;
+                    auto& n = describes[idx].name;
+                    return make_string<policy_type,string>(n.data(), n.size());
                 }
 
         };
@@ -374,15 +1152,72 @@ namespace cppstddb { namespace mysql {
 
         template<class P, typename T> struct field {};
 
-        template<class P> struct field<P,std::string> {
-            static std::string as(const rowset<P>& r, const cell_t<P>& cell) {
-                return static_cast<const char *>(cell.bind_.data);
+        template<class P, class A> struct field<P,std::basic_string<char,std::char_traits<char>,A>> {
+            using string = std::basic_string<char,std::char_traits<char>,A>;
+            static string as(const rowset<P>& r, const cell_t<P>& cell) {
+                return make_string<P,string>(r.value(cell.bind_), cell.bind_.length);
+            }
+        };
+
+        template<class P> struct field<P,std::experimental::string_view> {
+            static std::experimental::string_view as(const rowset<P>& r, const cell_t<P>& cell) {
+                return std::experimental::string_view(r.value(cell.bind_), cell.bind_.length);
             }
         };
 
+        // integer value of an integer or bit bind
+        template<class P> int64_t integer_value(const bind_type<P>& b) {
+            switch(b.mysql_type) {
+                case MYSQL_TYPE_LONG: return *static_cast<const int*>(b.data);
+                case MYSQL_TYPE_LONGLONG: return *static_cast<const int64_t*>(b.data);
+                case MYSQL_TYPE_DOUBLE: return static_cast<int64_t>(*static_cast<const double*>(b.data));
+                case MYSQL_TYPE_BIT: {
+                                         auto p = static_cast<const unsigned char*>(b.data);
+                                         uint64_t v = 0;
+                                         for(unsigned long i = 0; i != b.length; ++i) v = v << 8 | p[i];
+                                         return static_cast<int64_t>(v);
+                                     }
+            }
+            raise_error("mysql: not an integer column", b.mysql_type);
+            return 0;
+        }
+
         template<class P> struct field<P,int> {
             static int as(const rowset<P>& r, const cell_t<P>& cell) {
-                return *static_cast<int*>(cell.bind_.data);
+                auto& b = cell.bind_;
+                if (b.mysql_type == MYSQL_TYPE_LONG) return *static_cast<int*>(b.data);
+                return static_cast<int>(integer_value<P>(b));
+            }
+        };
+
+        template<class P> struct field<P,long> {
+            static long as(const rowset<P>& r, const cell_t<P>& cell) {return integer_value<P>(cell.bind_);}
+        };
+
+        template<class P> struct field<P,long long> {
+            static long long as(const rowset<P>& r, const cell_t<P>& cell) {return integer_value<P>(cell.bind_);}
+        };
+
+        template<class P> struct field<P,unsigned long long> {
+            static unsigned long long as(const rowset<P>& r, const cell_t<P>& cell) {
+                return static_cast<unsigned long long>(integer_value<P>(cell.bind_));
+            }
+        };
+
+        template<class P> struct field<P,double> {
+            static double as(const rowset<P>& r, const cell_t<P>& cell) {
+                auto& b = cell.bind_;
+                if (b.mysql_type == MYSQL_TYPE_DOUBLE) return *static_cast<double*>(b.data);
+                if (b.type == value_decimal) return decimal_t::text_to_double(r.value(b), b.length);
+                return static_cast<double>(integer_value<P>(b));
+            }
+        };
+
+        template<class P> struct field<P,decimal_t> {
+            static decimal_t as(const rowset<P>& r, const cell_t<P>& cell) {
+                auto& b = cell.bind_;
+                if (b.type == value_decimal) return decimal_t::parse(r.value(b), b.length);
+                return decimal_t(integer_value<P>(b), 0);
             }
         };
 
@@ -393,14 +1228,102 @@ namespace cppstddb { namespace mysql {
             }
         };
 
+        template<class P> struct field<P,datetime_t> {
+            static datetime_t as(const rowset<P>& r, const cell_t<P>& cell) {
+                auto& t = *static_cast<MYSQL_TIME*>(cell.bind_.data);
+                return datetime_t(t.year, t.month, t.day, t.hour, t.minute, t.second, t.second_part);
+            }
+        };
+
+        template<class P> struct field<P,std::chrono::microseconds> {
+            static std::chrono::microseconds as(const rowset<P>& r, const cell_t<P>& cell) {
+                auto& t = *static_cast<MYSQL_TIME*>(cell.bind_.data);
+                using namespace std::chrono;
+                auto d = hours(t.hour) + minutes(t.minute) + seconds(t.second) + microseconds(t.second_part);
+                return t.neg ? -d : d;
+            }
+        };
+
+        template<class P, class A> struct field<P,std::vector<unsigned char,A>> {
+            using blob = std::vector<unsigned char,A>;
+            static blob as(const rowset<P>& r, const cell_t<P>& cell) {
+                auto p = reinterpret_cast<const unsigned char*>(r.value(cell.bind_));
+                return blob(p, p + cell.bind_.length);
+            }
+        };
+
+        // parameter encoders (idx is 0 based), see statement::bind_param
+
+        template<class P, typename T> struct param {};
+
+        template<class P> struct param<P,int> {
+            static void bind(statement<P>& s, int idx, const int& v) {
+                s.bind_param(idx, MYSQL_TYPE_LONG, &v, sizeof(v));
+            }
+        };
+
+        template<class P> struct param<P,long> {
+            static void bind(statement<P>& s, int idx, const long& v) {
+                s.bind_param(idx, sizeof(v) == 8 ? MYSQL_TYPE_LONGLONG : MYSQL_TYPE_LONG, &v, sizeof(v));
+            }
+        };
+
+        template<class P> struct param<P,long long> {
+            static void bind(statement<P>& s, int idx, const long long& v) {
+                s.bind_param(idx, MYSQL_TYPE_LONGLONG, &v, sizeof(v));
+            }
+        };
+
+        template<class P> struct param<P,unsigned long long> {
+            static void bind(statement<P>& s, int idx, const unsigned long long& v) {
+                s.bind_param(idx, MYSQL_TYPE_LONGLONG, &v, sizeof(v), true);
+            }
+        };
+
+        template<class P> struct param<P,double> {
+            static void bind(statement<P>& s, int idx, const double& v) {
+                s.bind_param(idx, MYSQL_TYPE_DOUBLE, &v, sizeof(v));
+            }
+        };
+
+        template<class P> struct param<P,std::experimental::string_view> {
+            static void bind(statement<P>& s, int idx, const std::experimental::string_view& v) {
+                s.bind_param(idx, MYSQL_TYPE_STRING, v.data(), v.size());
+            }
+        };
+
+        template<class P, class A> struct param<P,std::basic_string<char,std::char_traits<char>,A>> {
+            static void bind(statement<P>& s, int idx, const std::basic_string<char,std::char_traits<char>,A>& v) {
+                s.bind_param(idx, MYSQL_TYPE_STRING, v.data(), v.size());
+            }
+        };
+
+        template<class P, class A> struct param<P,std::vector<unsigned char,A>> {
+            static void bind(statement<P>& s, int idx, const std::vector<unsigned char,A>& v) {
+                s.bind_param(idx, MYSQL_TYPE_BLOB, v.data(), v.size());
+            }
+        };
+
+        template<class P> struct param<P,std::nullptr_t> {
+            static void bind(statement<P>& s, int idx, std::nullptr_t) {
+                s.bind_param(idx, MYSQL_TYPE_NULL, nullptr, 0);
+            }
+        };
+
     }
 
-    using database = cppstddb::front::basic_database<impl::database<default_policy>>;
+    template<class P> using basic_database = cppstddb::front::basic_database<impl::database<P>>;
+    using database = basic_database<default_policy>;
+    using infile_row = impl::infile_row;
 
     inline auto create_database() {
         return database();
     }
 
+    template<class R> auto load_data(database::connection_t con, const std::string& table, R&& rows) {
+        return con.data_->load_data(table, std::forward<R>(rows));
+    }
+
 
 }}
 
@@ -157,6 +157,11 @@ namespace cppstddb { namespace oracle {
                     if (svc_ctx) check("OCILogoff", OCILogoff(svc_ctx, db.error));
                 }
 
+                void cancel() {
+                    DB_TRACE("con: cancel");
+                    check("OCIBreak", OCIBreak(svc_ctx, db.error));
+                }
+
         };
 
         template<class P> class statement {
@@ -195,11 +200,18 @@ namespace cppstddb { namespace oracle {
                      */
                 }
 
+                void prepare_direct() {prepare();}
+
                 statement& query() {
                     //check("mysql_stmt_execute", stmt, mysql_stmt_execute(stmt));
                     return *this;
                 }
 
+                bool try_query(error& e) {
+                    query();
+                    return true;
+                }
+
         };
 
         template<class P> struct describe_type {
@@ -438,9 +450,15 @@ namespace cppstddb { namespace oracle {
                     return 0;
                 }
 
-                auto name(size_t idx) {
+                int try_next(error& e) {
+                    return next();
+                }
+
+                bool is_null(int col) const {return false;}
+
+                std::string name(size_t idx) {
                     //return describes[idx].name;
-                    return "";
+                    return std::string();
                 }
 
         };
@@ -454,6 +472,12 @@ namespace cppstddb { namespace oracle {
             }
         };
 
+        template<class P> struct field<P,std::experimental::string_view> {
+            static std::experimental::string_view as(const rowset<P>& r, const cell_t<P>& cell) {
+                return static_cast<const char *>(cell.bind_.data);
+            }
+        };
+
         template<class P> struct field<P,int> {
             static int as(const rowset<P>& r, const cell_t<P>& cell) {
                 return *static_cast<int*>(cell.bind_.data);
@@ -470,7 +494,8 @@ namespace cppstddb { namespace oracle {
 
     }
 
-    using database = cppstddb::front::basic_database<impl::database<default_policy>>;
+    template<class P> using basic_database = cppstddb::front::basic_database<impl::database<P>>;
+    using database = basic_database<default_policy>;
 
     inline auto create_database() {
         return database();
@@ -0,0 +1,285 @@
+#ifndef CPPSTDDB_PARALLEL_H
+#define CPPSTDDB_PARALLEL_H
+
+#include <cppstddb/front.h>
+#include <cppstddb/value.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+   CPU heavy per row work spread over a pool of threads.  The calling
+   thread fetches, packing rows into blocks of row snapshots, and the
+   workers take the blocks: each has its own queue and steals from the
+   others when it runs dry.  At most two blocks per worker are in flight,
+   so memory stays bounded however large the result.
+
+     parallel_for_each(rows, f)          f(row) on the workers, any order
+     parallel_reduce(rows, init, f, m)   f(acc, row) into a per worker acc,
+                                         merged with m(acc, other) at the end
+     parallel_transform(rows, f, out)    f(row) on the workers, out(result)
+                                         on the calling thread in row order
+
+   threads 0 is one per core.  The first exception from a worker stops the
+   fetch and is rethrown once the workers have stopped.
+ */
+
+namespace cppstddb { namespace impl {
+
+    struct row_block {
+        size_t seq;
+        std::vector<row_snapshot> rows;
+    };
+
+    inline int pool_threads(int n) {
+        return n > 0 ? n : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    class block_pool {
+        public:
+            using work_type = std::function<void(int, row_block&)>;
+
+            // release_on_done: a block leaves the in flight count when work returns, else on release()
+            block_pool(int threads, work_type work, bool release_on_done = true):
+                work_(std::move(work)),
+                release_on_done_(release_on_done),
+                capacity_(2 * threads),
+                in_flight_(0),
+                completed_(0),
+                queued_(0),
+                next_(0),
+                closed_(false),
+                failed_(false) {
+                    for(int i = 0; i != threads; ++i) queues_.emplace_back(new queue());
+                    for(int i = 0; i != threads; ++i) threads_.emplace_back([this, i] {run(i);});
+                }
+
+            ~block_pool() {
+                close();
+            }
+
+            block_pool(const block_pool&) = delete;
+            block_pool& operator=(const block_pool&) = delete;
+
+            int size() const {return queues_.size();}
+            bool failed() const {return failed_;}
+
+            // queue a block, waiting for room; drain() runs on this thread while waiting
+            template<class Drain> void submit(row_block b, Drain drain) {
+                drain();
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (in_flight_ >= capacity_ && !failed_) {
+                    auto seen = completed_;
+                    lock.unlock();
+                    drain();
+                    lock.lock();
+                    if (in_flight_ < capacity_) break;
+                    cv_.wait(lock, [this, seen] {return completed_ != seen || failed_;});
+                }
+                ++in_flight_;
+                auto& q = *queues_[next_++ % queues_.size()];
+                {
+                    std::lock_guard<std::mutex> queue_lock(q.mutex);
+                    q.blocks.push_back(std::move(b));
+                    ++queued_;
+                }
+                lock.unlock();
+                cv_.notify_all();
+            }
+
+            void release() {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --in_flight_;
+            }
+
+            // wait for the queued blocks, rethrow the first worker error
+            void finish() {
+                close();
+                if (error_) std::rethrow_exception(error_);
+            }
+
+        private:
+            struct queue {
+                std::mutex mutex;
+                std::deque<row_block> blocks;
+            };
+
+            work_type work_;
+            bool release_on_done_;
+            size_t capacity_;
+            size_t in_flight_;
+            size_t completed_;
+            std::atomic<size_t> queued_;
+            size_t next_;
+            bool closed_;
+            std::atomic<bool> failed_;
+            std::exception_ptr error_;
+
+            std::vector<std::unique_ptr<queue>> queues_;
+            std::vector<std::thread> threads_;
+            std::mutex mutex_;
+            std::condition_variable cv_;
+
+            void close() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    closed_ = true;
+                }
+                cv_.notify_all();
+                for(auto& t : threads_) if (t.joinable()) t.join();
+            }
+
+            // own queue from the front, the others from the back
+            bool try_take(int worker, row_block& b) {
+                auto n = queues_.size();
+                for(size_t i = 0; i != n; ++i) {
+                    auto& q = *queues_[(worker + i) % n];
+                    std::lock_guard<std::mutex> lock(q.mutex);
+                    if (q.blocks.empty()) continue;
+                    if (i == 0) {
+                        b = std::move(q.blocks.front());
+                        q.blocks.pop_front();
+                    } else {
+                        b = std::move(q.blocks.back());
+                        q.blocks.pop_back();
+                    }
+                    --queued_;
+                    return true;
+                }
+                return false;
+            }
+
+            bool take(int worker, row_block& b) {
+                while (!try_take(worker, b)) {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this] {return queued_ || closed_;});
+                    if (!queued_ && closed_) return false;
+                }
+                return true;
+            }
+
+            void run(int worker) {
+                row_block b;
+                while (take(worker, b)) {
+                    if (!failed_) {
+                        try {
+                            work_(worker, b);
+                        } catch (...) {
+                            std::lock_guard<std::mutex> lock(mutex_);
+                            if (!error_) error_ = std::current_exception();
+                            failed_ = true;
+                        }
+                    }
+                    b.rows.clear();
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        ++completed_;
+                        if (release_on_done_) --in_flight_;
+                    }
+                    cv_.notify_all();
+                }
+            }
+    };
+
+    // fetch on the calling thread, block_rows rows per block
+    template<class D, class Drain> void submit_blocks(front::rowset<D>& rows, block_pool& pool, size_t block_rows, Drain drain) {
+        block_rows = std::max<size_t>(block_rows, 1);
+        size_t seq = 0;
+        while (!rows.empty() && !pool.failed()) {
+            row_block b;
+            b.seq = seq++;
+            b.rows.reserve(block_rows);
+            while (b.rows.size() != block_rows && !rows.empty()) {
+                b.rows.emplace_back(rows.front());
+                rows.next();
+            }
+            pool.submit(std::move(b), drain);
+        }
+    }
+
+}}
+
+namespace cppstddb {
+
+    template<class D, class F>
+        void parallel_for_each(front::rowset<D> rows, F f, int threads = 0, size_t block_rows = 256) {
+            impl::block_pool pool(impl::pool_threads(threads), [&f](int, impl::row_block& b) {
+                    for(const auto& row : b.rows) f(row);
+                    });
+            impl::submit_blocks(rows, pool, block_rows, [] {});
+            pool.finish();
+        }
+
+    /*
+       each worker starts from a copy of init (an identity such as 0 or an
+       empty container), so merge should not depend on the order
+     */
+    template<class D, class T, class F, class M>
+        T parallel_reduce(front::rowset<D> rows, T init, F f, M merge, int threads = 0, size_t block_rows = 256) {
+            struct alignas(64) slot {T acc;}; // one cache line per worker
+            threads = impl::pool_threads(threads);
+            std::vector<slot> slots(threads, slot{init});
+            impl::block_pool pool(threads, [&f, &slots](int worker, impl::row_block& b) {
+                    auto& acc = slots[worker].acc;
+                    for(const auto& row : b.rows) f(acc, row);
+                    });
+            impl::submit_blocks(rows, pool, block_rows, [] {});
+            pool.finish();
+
+            T result = std::move(slots[0].acc);
+            for(int i = 1; i != threads; ++i) merge(result, static_cast<const T&>(slots[i].acc));
+            return result;
+        }
+
+    template<class D, class F, class O>
+        void parallel_transform(front::rowset<D> rows, F f, O out, int threads = 0, size_t block_rows = 256) {
+            using result_type = typename std::decay<decltype(f(std::declval<const row_snapshot&>()))>::type;
+            using results = std::vector<result_type>;
+
+            std::mutex mutex;
+            std::map<size_t, results> done; // finished blocks waiting for their turn
+            size_t next = 0;
+
+            impl::block_pool pool(impl::pool_threads(threads), [&](int, impl::row_block& b) {
+                    results r;
+                    r.reserve(b.rows.size());
+                    for(const auto& row : b.rows) r.push_back(f(row));
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done.emplace(b.seq, std::move(r));
+                    }, false);
+
+            // hand finished blocks to out in order, freeing their slots
+            auto drain = [&] {
+                while (true) {
+                    results r;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        auto i = done.find(next);
+                        if (i == done.end()) return;
+                        r = std::move(i->second);
+                        done.erase(i);
+                    }
+                    ++next;
+                    for(auto& x : r) out(std::move(x));
+                    pool.release();
+                }
+            };
+
+            impl::submit_blocks(rows, pool, block_rows, drain);
+            pool.finish();
+            drain();
+        }
+
+}
+
+#endif
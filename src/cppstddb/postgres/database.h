@@ -6,8 +6,10 @@
 #include <cppstddb/endian.h>
 #include <vector>
 #include <libpq-fe.h>
+#include <libpq/libpq-fs.h>
 #include <pgtypes_date.h>
 #include <cstring>
+#include <cstdio>
 
 /* from catalog/pg_type.h,
    this header location appears to jump around so 
@@ -42,6 +44,7 @@ namespace cppstddb { namespace postgres {
 		template<class P> class rowset;
 		template<class P> class bind_type;
 		template<class P,class T> class field;
+		template<class P,class T> struct param;
 
 		template<class P> using cell_t = cppstddb::front::cell<database<P>>;
 
@@ -59,6 +62,77 @@ namespace cppstddb { namespace postgres {
 			throw database_error(s);
 		}
 
+		inline error_kind error_kind_of(const char* sqlstate) {
+			if (!strcmp(sqlstate, "23505")) return error_kind::unique_violation;
+			if (!strcmp(sqlstate, "40001") || !strcmp(sqlstate, "40P01")) return error_kind::serialization_failure;
+			if (!strcmp(sqlstate, "55P03")) return error_kind::lock_timeout;
+			return error_kind::other;
+		}
+
+		// the message is read from res when asked for
+		inline error make_error(const char* where, const PGresult* res) {
+			const char* sqlstate = res ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : nullptr;
+			if (!sqlstate) sqlstate = "";
+			return error(error_kind_of(sqlstate), where, PQresultStatus(res), sqlstate,
+					[](const void* h) {return static_cast<const char*>(PQresultErrorMessage(static_cast<const PGresult*>(h)));}, res);
+		}
+
+		/*
+		   uri options: port (or host:port) and socket (the socket directory,
+		   used as host); anything else is passed to libpq as a connection
+		   keyword, e.g. connect_timeout, sslmode or application_name
+		 */
+
+		inline void add_conninfo(std::string& conninfo, const std::string& key, const std::string& value) {
+			if (value.empty()) return;
+			if (!conninfo.empty()) conninfo += ' ';
+			conninfo += key;
+			conninfo += "='";
+			for(char c : value) {
+				if (c == '\\' || c == '\'') conninfo += '\\';
+				conninfo += c;
+			}
+			conninfo += '\'';
+		}
+
+		// uri options passed to libpq, others (generic or for other drivers) are ignored
+		inline bool is_conninfo_keyword(const std::string& key) {
+			static const char* const keywords[] = {
+				"connect_timeout", "client_encoding", "options", "application_name",
+				"fallback_application_name", "keepalives", "keepalives_idle",
+				"keepalives_interval", "keepalives_count", "tcp_user_timeout",
+				"sslmode", "sslcompression", "sslcert", "sslkey", "sslpassword",
+				"sslrootcert", "sslcrl", "sslsni", "requirepeer", "gssencmode",
+				"krbsrvname", "service", "passfile", "target_session_attrs", "hostaddr"};
+			for(auto k : keywords) if (key == k) return true;
+			return false;
+		}
+
+		inline std::string get_conninfo(const source& src) {
+			std::string host = src.server, port = src.port ? std::to_string(src.port) : "";
+			auto colon = host.rfind(':');
+			if (port.empty() && colon != std::string::npos && host.find(':') == colon) {
+				port = host.substr(colon + 1);
+				host.erase(colon);
+			}
+			if (src.has_option("socket")) host = src.option("socket");
+
+			std::string conninfo;
+			add_conninfo(conninfo, "host", host);
+			add_conninfo(conninfo, "port", port);
+			add_conninfo(conninfo, "dbname", src.database);
+			add_conninfo(conninfo, "user", src.username);
+			add_conninfo(conninfo, "password", src.password);
+			for(auto& o : src.options) {
+				if (is_conninfo_keyword(o.first)) {
+					add_conninfo(conninfo, o.first, o.second);
+				} else if (o.first != "socket") {
+					DB_WARN("postgres: ignoring option " << o.first);
+				}
+			}
+			return conninfo;
+		}
+
 		template<class P> class database {
 			public:
 				using policy_type = P;
@@ -68,6 +142,7 @@ namespace cppstddb { namespace postgres {
 				using rowset = rowset<policy_type>;
 				using bind_type = bind_type<policy_type>;
 				template<typename T> using field_type = field<policy_type,T>;
+				template<typename T> using param_type = param<policy_type,T>;
 
 				database() {
 					DB_TRACE("db");
@@ -89,24 +164,114 @@ namespace cppstddb { namespace postgres {
 
 				database& db;
 				PGconn *con;
+				PGcancel *cancel_handle;
 
-				connection(database& db_, const source& src):db(db_) {
+				connection(database& db_, const source& src):db(db_),cancel_handle(nullptr) {
 					DB_TRACE("con, source: " << src);
 
-					string conninfo;
-					conninfo += "host=";
-					conninfo += src.server;
-					conninfo += " dbname=";
-					conninfo += src.database;
-					DB_TRACE("conninfo:" << conninfo);
+					auto conninfo = get_conninfo(src);
 					con = PQconnectdb(conninfo.c_str());
 					if (PQstatus(con) != CONNECTION_OK) raise_error(con, "login error");
+					cancel_handle = PQgetCancel(con);
 				}
 
 				~connection() {
 					DB_TRACE("~con");
+					if (cancel_handle) PQfreeCancel(cancel_handle);
 					PQfinish(con);
 				}
+
+				// PQcancel is safe to call from another thread
+				void cancel() {
+					DB_TRACE("con: cancel");
+					char error[256];
+					if (!cancel_handle) raise_error("cancel: no cancel handle");
+					if (!PQcancel(cancel_handle, error, sizeof(error))) {
+						std::string s = "PQcancel: ";
+						s += error;
+						raise_error(s);
+					}
+				}
+
+				void begin() {exec(con, "begin");}
+				void commit() {exec(con, "commit");}
+				void rollback() {exec(con, "rollback");}
+
+				/*
+				   large objects, streamed with lo_write / lo_read in chunks;
+				   outside a transaction each call runs in its own
+				 */
+
+				template<class S> Oid write_large_object(S source, size_t chunk) {
+					transaction t(con);
+					Oid oid = lo_creat(con, INV_READ | INV_WRITE);
+					if (oid == InvalidOid) raise_error(con, "lo_creat");
+					large_object lo(con, oid, INV_WRITE);
+					std::vector<char> buf(chunk);
+					while (auto n = source(buf.data(), buf.size())) {
+						if (lo_write(con, lo.fd, buf.data(), n) != static_cast<int>(n)) raise_error(con, "lo_write");
+					}
+					lo.close();
+					t.commit();
+					return oid;
+				}
+
+				template<class F> void read_large_object(Oid oid, F f, size_t chunk) {
+					transaction t(con);
+					large_object lo(con, oid, INV_READ);
+					std::vector<char> buf(chunk);
+					int n;
+					while ((n = lo_read(con, lo.fd, buf.data(), buf.size())) > 0) {
+						f(static_cast<const char*>(buf.data()), static_cast<size_t>(n));
+					}
+					if (n < 0) raise_error(con, "lo_read");
+					lo.close();
+					t.commit();
+				}
+
+				void unlink_large_object(Oid oid) {
+					if (lo_unlink(con, oid) < 0) raise_error(con, "lo_unlink");
+				}
+
+			private:
+				static void exec(PGconn* con, const char* sql) {
+					auto res = PQexec(con, sql);
+					auto ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+					PQclear(res);
+					if (!ok) raise_error(con, sql);
+				}
+
+				// begin/commit unless the caller already has a transaction open
+				struct transaction {
+					PGconn* con;
+					bool own;
+					transaction(PGconn* c):con(c),own(PQtransactionStatus(c) == PQTRANS_IDLE) {
+						if (own) exec(con, "begin");
+					}
+					~transaction() {
+						if (own) PQclear(PQexec(con, "rollback"));
+					}
+					void commit() {
+						if (own) exec(con, "commit");
+						own = false;
+					}
+				};
+
+				struct large_object {
+					PGconn* con;
+					int fd;
+					large_object(PGconn* c, Oid oid, int mode):con(c),fd(lo_open(c, oid, mode)) {
+						if (fd < 0) raise_error(con, "lo_open");
+					}
+					~large_object() {
+						if (fd >= 0) lo_close(con, fd);
+					}
+					void close() {
+						int ret = lo_close(con, fd);
+						fd = -1;
+						if (ret < 0) raise_error(con, "lo_close");
+					}
+				};
 		};
 
 		template<class P> class statement {
@@ -122,38 +287,88 @@ namespace cppstddb { namespace postgres {
 				PGresult *res;
 				string sql_;
 				string name;
+				bool direct;
 
 				std::vector<char*> bindValue;
 				std::vector<Oid> bindtype;
 				std::vector<int> bindLength;
 				std::vector<int> bindFormat;
+				std::vector<std::string> bindData; // values, a length of -1 is null
 			public:
 
-				statement(connection& c, const string& sql):con(c.con), sql_(sql) {
+				statement(connection& c, const string& sql):
+					con(c.con),
+					prepare_res(nullptr),
+					res(nullptr),
+					sql_(sql, policy_type::template get_allocator<char>()),
+					direct(false) {
 					DB_TRACE("stmt: " << sql);
 				}
 
 				~statement() {
 					DB_TRACE("~stmt");
+					if (res) PQclear(res);
+					if (prepare_res) PQclear(prepare_res);
+				}
+
+				void begin_bind() {
+					bindData.clear();
+					bindLength.clear();
+					bindFormat.clear();
+				}
+
+				// text (format 0) or binary (format 1) value, null when p is null
+				void bind_param(int idx, const char* p, size_t n, int format) {
+					if (idx < 0) raise_error("bind_param: no such parameter: " + std::to_string(idx));
+					auto size = static_cast<size_t>(idx) + 1;
+					if (bindData.size() < size) {
+						bindData.resize(size);
+						bindLength.resize(size, -1);
+						bindFormat.resize(size, 0);
+					}
+					if (p) bindData[idx].assign(p, n);
+					bindLength[idx] = p ? n : -1;
+					bindFormat[idx] = format;
 				}
 
 				statement& query() {
-					if (!prepare_res) prepare();
-					auto n = bindValue.size();
+					error e;
+					if (!try_query(e)) e.raise();
+					return *this;
+				}
+
+				bool try_query(error& e) {
+					if (!prepare_res && !direct) prepare();
+					auto n = bindData.size();
+					bindValue.resize(n);
+					for(size_t i = 0; i != n; ++i) {
+						bindValue[i] = bindLength[i] < 0 ? nullptr : &bindData[i][0];
+					}
 					int resultFormat = 1; // results in binary format
 
-					res = PQexecPrepared(
-							con,
-							name.c_str(),
-							n,
-							n ? static_cast<char **>(&bindValue[0]) : nullptr,
-							n ? static_cast<int*>(&bindLength[0]) : nullptr,
-							n ? static_cast<int*>(&bindFormat[0]) : nullptr,
-							resultFormat);
-					return *this;
+					auto values = n ? static_cast<char **>(&bindValue[0]) : nullptr;
+					auto lengths = n ? static_cast<int*>(&bindLength[0]) : nullptr;
+					auto formats = n ? static_cast<int*>(&bindFormat[0]) : nullptr;
+
+					if (res) PQclear(res);
+					res = direct ?
+						PQexecParams(con, sql_.c_str(), n, nullptr, values, lengths, formats, resultFormat) :
+						PQexecPrepared(con, name.c_str(), n, values, lengths, formats, resultFormat);
+					switch(PQresultStatus(res)) {
+						case PGRES_COMMAND_OK:
+						case PGRES_TUPLES_OK:
+						case PGRES_EMPTY_QUERY: return true;
+						default: break;
+					}
+					e = make_error(direct ? "PQexecParams" : "PQexecPrepared", res);
+					return false;
 				}
 
+				// execute-direct: no PQprepare round trip, PQexecParams sends the sql with the values
+				void prepare_direct() {direct = true;}
+
 				void prepare()  {
+					direct = false;
 					const Oid* paramTypes;
 					prepare_res = PQprepare(
 							con,
@@ -199,8 +414,8 @@ namespace cppstddb { namespace postgres {
 				bool hasResult_;
 			public:
 				using describe_type = describe_type<policy_type>;
-				using describe_vector = std::vector<describe_type>;
-				using bind_vector = std::vector<bind_type>;
+				using describe_vector = typename policy_type::template vector<describe_type>;
+				using bind_vector = typename policy_type::template vector<bind_type>;
 
 				describe_vector describes;
 				bind_vector binds;
@@ -213,7 +428,9 @@ namespace cppstddb { namespace postgres {
 					res(stmt.res),
 					columns(0),
 					row(0),
-					rows(0)
+					rows(0),
+					describes(policy_type::template get_allocator<describe_type>()),
+					binds(policy_type::template get_allocator<bind_type>())
 			{
 				setup();
 				build_describe();
@@ -253,12 +470,11 @@ namespace cppstddb { namespace postgres {
 					DB_TRACE("build describe: columns: " << columns);
 
 					for (int col = 0; col != columns; col++) {
-						describes.push_back(describe_type());
-						auto& d = describes.back();
-
-						d.dbType = static_cast<int>(PQftype(res, col));
-						d.format = PQfformat(res, col);
-						d.name = PQfname(res, col);
+						auto name = PQfname(res, col);
+						describes.push_back(describe_type{
+								static_cast<int>(PQftype(res, col)),
+								PQfformat(res, col),
+								make_string<policy_type,string>(name, strlen(name))});
 					}
 				}
 
@@ -283,13 +499,16 @@ namespace cppstddb { namespace postgres {
 				}
 
 				int fetch() {
-					return 1;
+					return rows ? 1 : 0;
 				}
 
 				int next() {
 					return ++row != rows ? 1 :0;
 				}
 
+				// the rows are all in the result, nothing left to fail
+				int try_next(error&) {return next();}
+
 				void close() {
 					if (!res) raise_error("couldn't close result: result was not open");
 					res = PQgetResult(con);
@@ -302,6 +521,19 @@ namespace cppstddb { namespace postgres {
 				int type(int col) const {return describes[col].dbType;}
 				int format(int col) const {return describes[col].format;}
 				int len(int col) const {return PQgetlength(res, row, col);}
+
+				// the value is already in the result, hand it out in slices
+				template<class F> void read_chunks(int col, F f, size_t chunk) const {
+					if (is_null(col)) return;
+					auto p = static_cast<const char*>(data(col));
+					size_t n = len(col);
+					for(size_t i = 0; i < n; i += chunk) f(p + i, std::min(chunk, n - i));
+				}
+
+				auto name(size_t idx) {
+					auto& n = describes[idx].name;
+					return make_string<policy_type,string>(n.data(), n.size());
+				}
 		};
 
 		inline void check_type(int a, int b) {
@@ -310,9 +542,18 @@ namespace cppstddb { namespace postgres {
 
 		template<class P, typename T> struct field {};
 
-		template<class P> struct field<P,std::string> {
-			static std::string as(const rowset<P>& r, const cell_t<P>& cell) {
-				return static_cast<const char *>(r.data(cell.bind_.idx));
+		template<class P, class A> struct field<P,std::basic_string<char,std::char_traits<char>,A>> {
+			using string = std::basic_string<char,std::char_traits<char>,A>;
+			static string as(const rowset<P>& r, const cell_t<P>& cell) {
+				auto idx = cell.bind_.idx;
+				return make_string<P,string>(static_cast<const char *>(r.data(idx)), r.len(idx));
+			}
+		};
+
+		template<class P> struct field<P,std::experimental::string_view> {
+			static std::experimental::string_view as(const rowset<P>& r, const cell_t<P>& cell) {
+				auto idx = cell.bind_.idx;
+				return std::experimental::string_view(static_cast<const char *>(r.data(idx)), r.len(idx));
 			}
 		};
 
@@ -339,14 +580,78 @@ namespace cppstddb { namespace postgres {
 			}
 		};
 
+		// parameter encoders (idx is 0 based), numbers are sent as text
+
+		template<class P, typename T> struct param {};
+
+		template<class P, class T> void bind_number(statement<P>& s, int idx, const char* format, T v) {
+			char buf[32];
+			int n = snprintf(buf, sizeof(buf), format, v);
+			s.bind_param(idx, buf, n, 0);
+		}
+
+		template<class P> struct param<P,int> {
+			static void bind(statement<P>& s, int idx, int v) {bind_number(s, idx, "%d", v);}
+		};
+
+		template<class P> struct param<P,long> {
+			static void bind(statement<P>& s, int idx, long v) {bind_number(s, idx, "%ld", v);}
+		};
+
+		template<class P> struct param<P,long long> {
+			static void bind(statement<P>& s, int idx, long long v) {bind_number(s, idx, "%lld", v);}
+		};
+
+		template<class P> struct param<P,double> {
+			static void bind(statement<P>& s, int idx, double v) {bind_number(s, idx, "%.17g", v);}
+		};
+
+		template<class P> struct param<P,std::experimental::string_view> {
+			static void bind(statement<P>& s, int idx, std::experimental::string_view v) {
+				s.bind_param(idx, v.data(), v.size(), 0);
+			}
+		};
+
+		template<class P, class A> struct param<P,std::basic_string<char,std::char_traits<char>,A>> {
+			static void bind(statement<P>& s, int idx, const std::basic_string<char,std::char_traits<char>,A>& v) {
+				s.bind_param(idx, v.data(), v.size(), 0);
+			}
+		};
+
+		template<class P, class A> struct param<P,std::vector<unsigned char,A>> {
+			static void bind(statement<P>& s, int idx, const std::vector<unsigned char,A>& v) {
+				s.bind_param(idx, reinterpret_cast<const char*>(v.data()), v.size(), 1);
+			}
+		};
+
+		template<class P> struct param<P,std::nullptr_t> {
+			static void bind(statement<P>& s, int idx, std::nullptr_t) {s.bind_param(idx, nullptr, 0, 0);}
+		};
+
 	}
 
-	using database = cppstddb::front::basic_database<impl::database<default_policy>>;
+	template<class P> using basic_database = cppstddb::front::basic_database<impl::database<P>>;
+	using database = basic_database<default_policy>;
 
 	inline auto create_database() {
 		return database();
 	}
 
+	// stream source: size_t(char* buf, size_t n), 0 at the end, into a new large object
+	template<class S> Oid write_large_object(database::connection_t con, S source, size_t chunk_size = front::lob_chunk_size) {
+		return con.data_->write_large_object(source, chunk_size);
+	}
+
+	// stream large object oid to f(const char*, size_t)
+	template<class F> void read_large_object(database::connection_t con, Oid oid, F f, size_t chunk_size = front::lob_chunk_size) {
+		con.data_->read_large_object(oid, f, chunk_size);
+	}
+
+	// delete large object oid
+	inline void unlink_large_object(database::connection_t con, Oid oid) {
+		con.data_->unlink_large_object(oid);
+	}
+
 
 }}
 
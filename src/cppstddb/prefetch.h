@@ -0,0 +1,194 @@
+#ifndef CPPSTDDB_PREFETCH_H
+#define CPPSTDDB_PREFETCH_H
+
+#include <cppstddb/front.h>
+#include <cppstddb/value.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+   Overlaps fetching with processing for long scans.  A helper thread reads
+   the rowset into one block of row snapshots while the consumer works
+   through the other, the two swap when the consumer is done with its
+   block.  At most two blocks are held.  Each block has a full flag that
+   the two sides hand back and forth, a side only takes the lock to sleep
+   when the other is behind.
+
+   The rowset (and its connection) belongs to the helper thread until the
+   scan ends, errors from the fetch are rethrown to the consumer after the
+   rows read before them.
+ */
+
+namespace cppstddb { namespace front {
+
+    template<class D> class prefetch_rowset {
+        public:
+            using database_type = D;
+            using rowset_t = rowset<database_type>;
+
+            class iterator {
+                public:
+                    typedef std::ptrdiff_t difference_type;
+                    typedef row_snapshot value_type;
+                    typedef const row_snapshot& reference;
+                    typedef const row_snapshot* pointer;
+                    typedef std::input_iterator_tag iterator_category;
+                    typedef std::input_iterator_tag iterator_concept;
+
+                    iterator():rows_(nullptr) {}
+                    iterator(prefetch_rowset* r):rows_(r) {}
+                    const row_snapshot& operator*() const {return rows_->front();}
+                    const row_snapshot* operator->() const {return &rows_->front();}
+                    iterator& operator++() {
+                        rows_->pop_front();
+                        return *this;
+                    }
+                    void operator++(int) {rows_->pop_front();}
+                    bool at_end() const {return !rows_ || rows_->empty();}
+                    bool operator==(const iterator& rhs) const {return at_end() == rhs.at_end();}
+                    bool operator!=(const iterator& rhs) const {return !operator==(rhs);}
+
+                private:
+                    prefetch_rowset* rows_;
+            };
+
+            prefetch_rowset(rowset_t rows, size_t block_rows = 1024):
+                rows_(rows),
+                block_rows_(std::max<size_t>(block_rows, 1)),
+                current_(nullptr),
+                pos_(0),
+                idx_(0),
+                waiters_(0),
+                stop_(false) {
+                    for(auto& b : blocks_) b.rows.reserve(block_rows_);
+                    thread_ = std::thread([this] {run();});
+                }
+
+            ~prefetch_rowset() {
+                stop_ = true;
+                wake();
+                thread_.join();
+            }
+
+            prefetch_rowset(const prefetch_rowset&) = delete;
+            prefetch_rowset& operator=(const prefetch_rowset&) = delete;
+
+            bool empty() {
+                acquire();
+                return pos_ == current_->rows.size();
+            }
+
+            const row_snapshot& front() {
+                acquire();
+                return current_->rows[pos_];
+            }
+
+            void pop_front() {
+                acquire();
+                ++pos_;
+            }
+
+            iterator begin() {return iterator(this);}
+            iterator end() {return iterator(nullptr);}
+
+        private:
+            struct block {
+                std::vector<row_snapshot> rows;
+                bool last = false;
+                std::exception_ptr error;
+                std::atomic<bool> full{false};
+            };
+
+            rowset_t rows_;
+            size_t block_rows_;
+            block blocks_[2];
+            block* current_; // consumer side
+            size_t pos_;
+            int idx_;
+
+            std::atomic<int> waiters_;
+            std::atomic<bool> stop_;
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            std::thread thread_;
+
+            /*
+               make current_ a block with an unread row, or the last one; the
+               rows read before a fetch error come first, then every call
+               rethrows it
+             */
+            void acquire() {
+                if (!current_ || (pos_ == current_->rows.size() && !current_->last)) {
+                    if (current_) {
+                        current_->full.store(false);
+                        wake();
+                        idx_ ^= 1;
+                    }
+                    auto& b = blocks_[idx_];
+                    wait([&b] {return b.full.load();});
+                    current_ = &b;
+                    pos_ = 0;
+                }
+                if (pos_ == current_->rows.size() && current_->error) std::rethrow_exception(current_->error);
+            }
+
+            // helper thread
+            void run() {
+                int idx = 0;
+                while (true) {
+                    auto& b = blocks_[idx];
+                    wait([this, &b] {return !b.full.load() || stop_.load();});
+                    if (stop_) return;
+
+                    b.rows.clear();
+                    try {
+                        while (b.rows.size() != block_rows_ && !rows_.empty()) {
+                            b.rows.emplace_back(rows_.front());
+                            rows_.next();
+                        }
+                        b.last = rows_.empty();
+                    } catch (...) {
+                        b.error = std::current_exception();
+                        b.last = true;
+                    }
+
+                    b.full.store(true);
+                    wake();
+                    if (b.last) return;
+                    idx ^= 1;
+                }
+            }
+
+            template<class F> void wait(F ready) {
+                if (ready()) return;
+                std::unique_lock<std::mutex> lock(mutex_);
+                ++waiters_;
+                cv_.wait(lock, ready);
+                --waiters_;
+            }
+
+            void wake() {
+                if (waiters_) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    cv_.notify_all();
+                }
+            }
+    };
+
+}}
+
+namespace cppstddb {
+
+    // read rows ahead on a helper thread, in blocks of block_rows
+    template<class D> front::prefetch_rowset<D> prefetch(front::rowset<D> rows, size_t block_rows = 1024) {
+        return front::prefetch_rowset<D>(rows, block_rows);
+    }
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef CPPSTDDB_RESULT_H
+#define CPPSTDDB_RESULT_H
+
+#include <cppstddb/database_error.h>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <variant>
+
+/*
+   Failures as values for the try_ calls (try_query, try_next), where an
+   error such as a unique violation is an expected outcome rather than an
+   exception.  An error is a few words: the kind, the vendor code, the
+   SQLSTATE and the failing call.  The driver's message text is not copied,
+   message() reads it from the connection or statement when asked, so it
+   is only valid until the next call on that handle; the front end keeps
+   the handles alive for as long as the error (see keep()).  raise()
+   throws the usual database_error.
+ */
+
+namespace cppstddb {
+
+    enum class error_kind {
+        none,
+        unique_violation,
+        serialization_failure,  // also deadlocks, retry the transaction
+        lock_timeout,           // lock not available or busy
+        timeout,                // statement deadline passed
+        overloaded,             // refused by admission control
+        other
+    };
+
+    class error {
+        public:
+            using detail_type = const char* (*)(const void*);
+
+            error():kind_(error_kind::none),code_(0),sqlstate_{},where_(nullptr),detail_(nullptr),handle_(nullptr) {}
+
+            // where: a string literal; detail(handle) gives the driver message
+            error(error_kind kind, const char* where, int code, const char* sqlstate = nullptr,
+                    detail_type detail = nullptr, const void* handle = nullptr):
+                kind_(kind),
+                code_(code),
+                sqlstate_{},
+                where_(where),
+                detail_(detail),
+                handle_(handle) {
+                    if (sqlstate) memcpy(sqlstate_, sqlstate, strnlen(sqlstate, 5));
+                }
+
+            // failed
+            explicit operator bool() const {return kind_ != error_kind::none;}
+
+            error_kind kind() const {return kind_;}
+            int code() const {return code_;}
+            const char* sqlstate() const {return sqlstate_;} // empty when the driver has none
+            const char* where() const {return where_ ? where_ : "";}
+
+            void set_kind(error_kind kind) {kind_ = kind;}
+
+            // hold what the detail handle points into (error path only): no allocation
+            void keep(std::shared_ptr<const void> connection, std::shared_ptr<const void> statement) {
+                connection_ = std::move(connection);
+                statement_ = std::move(statement);
+            }
+
+            const char* detail() const {return detail_ ? detail_(handle_) : "";}
+
+            std::string message() const {
+                std::string s = where();
+                if (*sqlstate_) s.append(", sqlstate: ").append(sqlstate_);
+                auto d = detail();
+                if (*d) s.append(", ").append(d);
+                return s;
+            }
+
+            [[noreturn]] void raise() const {
+                if (kind_ == error_kind::timeout) throw timeout_error("query deadline exceeded", detail());
+                if (kind_ == error_kind::overloaded) throw overload_error(where());
+                throw database_error(where(), code_, detail());
+            }
+
+            friend std::ostream& operator<<(std::ostream& os, const error& e) {
+                return os << e.message() << " (" << e.code_ << ")";
+            }
+
+        private:
+            error_kind kind_;
+            int code_;
+            char sqlstate_[6];
+            const char* where_;
+            detail_type detail_;
+            const void* handle_;
+            std::shared_ptr<const void> connection_;
+            std::shared_ptr<const void> statement_;
+    };
+
+    // a T or the error that prevented it
+    template<class T> class result {
+        public:
+            result(T v):v_(std::move(v)) {}
+            result(cppstddb::error e):v_(e) {}
+
+            bool has_value() const {return v_.index() == 0;}
+            explicit operator bool() const {return has_value();}
+
+            T& value() {
+                if (!has_value()) error().raise();
+                return std::get<0>(v_);
+            }
+
+            T& operator*() {return std::get<0>(v_);}
+            T* operator->() {return &std::get<0>(v_);}
+
+            // none when there is a value
+            cppstddb::error error() const {return has_value() ? cppstddb::error() : std::get<1>(v_);}
+
+        private:
+            std::variant<T, cppstddb::error> v_;
+    };
+
+    template<> class result<void> {
+        public:
+            result() {}
+            result(cppstddb::error e):error_(e) {}
+
+            bool has_value() const {return !error_;}
+            explicit operator bool() const {return has_value();}
+            void value() const {if (error_) error_.raise();}
+            cppstddb::error error() const {return error_;}
+
+        private:
+            cppstddb::error error_;
+    };
+
+}
+
+#endif
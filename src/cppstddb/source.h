@@ -1,27 +1,67 @@
 #ifndef SOURCE_H
 #define SOURCE_H
 
+#include <cppstddb/database_error.h>
 #include <string>
 #include <ostream>
+#include <map>
+#include <cstdlib>
+#include <cerrno>
 
 namespace cppstddb {
     struct source {
         typedef std::string string;
         string protocol;
         string server;
-        int port;
+        int port = 0;
         string database;
         string username;
         string password;
+
+        // remaining uri query parameters, interpreted by each driver
+        std::map<string,string> options;
+
+        bool has_option(const string& key) const {return options.count(key) != 0;}
+
+        string option(const string& key, const string& def = string()) const {
+            auto i = options.find(key);
+            return i == options.end() ? def : i->second;
+        }
+
+        long long option_int(const string& key, long long def) const {
+            auto i = options.find(key);
+            return i == options.end() ? def : parse_int(key, i->second);
+        }
+
+        bool option_bool(const string& key, bool def) const {
+            auto i = options.find(key);
+            if (i == options.end()) return def;
+            auto& v = i->second;
+            if (v.empty() || v == "1" || v == "true" || v == "yes" || v == "on") return true;
+            if (v == "0" || v == "false" || v == "no" || v == "off") return false;
+            throw database_error("source: option " + key + ": not a boolean: " + v);
+        }
+
+        static long long parse_int(const string& key, const string& value) {
+            char* end;
+            errno = 0;
+            auto v = std::strtoll(value.c_str(), &end, 10);
+            if (value.empty() || *end || errno) {
+                throw database_error("source: option " + key + ": not an integer: " + value);
+            }
+            return v;
+        }
     };
 
     std::ostream& operator<<(std::ostream& os, const source &s) {
         os << "(";
         os << "protocol: " << s.protocol;
         os << ", server: " << s.server;
+        if (s.port) os << ", port: " << s.port;
         os << ", database: " << s.database;
         os << ", username: " << s.username;
         os << ", password: " << "*****";
+        for(auto& o : s.options) os << ", " << o.first << ": " << o.second;
         os << ")";
         return os;
     }
@@ -3,19 +3,16 @@
 
 #include <string>
 #include <cppstddb/log.h>
-#include <cppstddb/database_error.h>
+#include <cppstddb/front.h>
 
 namespace cppstddb {
 
+    // a missing table (or a missing if exists) is routine here: no exceptions
     template<class database> void drop_table(database& db, const std::string& table) {
-        try {
-            std::string s;
-            s += "drop table ";
-            s += table;
-            db.query(s);
-        } catch (database_error& e) {
-            DB_WARN("drop table error (ignored): " << e.what());
-        }
+        if (db.statement("drop table if exists " + table, execution::direct).try_query()) return;
+        // no if exists (oracle before 23c)
+        auto r = db.statement("drop table " + table, execution::direct).try_query();
+        if (!r) DB_WARN("drop table error (ignored): " << r.error());
     }
 
 }
@@ -0,0 +1,97 @@
+#ifndef CPPSTDDB_SQLITE_BLOB_H
+#define CPPSTDDB_SQLITE_BLOB_H
+
+#include <cppstddb/sqlite/database.h>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+
+/*
+   Incremental i/o on one blob (or text) value with sqlite3_blob_open, for
+   values too large to bind or read whole.  A blob cannot change size this
+   way: write with insert ... zeroblob(n) first, then fill it in.
+ */
+
+namespace cppstddb { namespace sqlite {
+
+	class blob_stream {
+		public:
+			blob_stream(
+					sqlite3* sq,
+					const std::string& table,
+					const std::string& column,
+					sqlite3_int64 rowid,
+					bool writable = false,
+					const std::string& db = "main"):
+				sq_(sq),
+				blob_(nullptr) {
+					impl::check("sqlite3_blob_open", sq_, sqlite3_blob_open(
+								sq_,
+								db.c_str(),
+								table.c_str(),
+								column.c_str(),
+								rowid,
+								writable,
+								&blob_));
+				}
+
+			template<class C> blob_stream(
+					C& con,
+					const std::string& table,
+					const std::string& column,
+					sqlite3_int64 rowid,
+					bool writable = false):
+				blob_stream(con.data_->sq, table, column, rowid, writable) {}
+
+			~blob_stream() {
+				if (blob_) impl::check_nothrow("sqlite3_blob_close", sqlite3_blob_close(blob_));
+			}
+
+			blob_stream(const blob_stream&) = delete;
+			blob_stream& operator=(const blob_stream&) = delete;
+
+			size_t size() const {return sqlite3_blob_bytes(blob_);}
+
+			void read(size_t offset, char* buf, size_t n) {
+				impl::check("sqlite3_blob_read", sq_, sqlite3_blob_read(blob_, buf, n, offset));
+			}
+
+			void write(size_t offset, const char* data, size_t n) {
+				impl::check("sqlite3_blob_write", sq_, sqlite3_blob_write(blob_, data, n, offset));
+			}
+
+			// move to another row of the same table and column
+			void reopen(sqlite3_int64 rowid) {
+				impl::check("sqlite3_blob_reopen", sq_, sqlite3_blob_reopen(blob_, rowid));
+			}
+
+			// whole value to f(const char*, size_t), chunk bytes at a time
+			template<class F> void read_chunks(F f, size_t chunk_size = front::lob_chunk_size) {
+				std::vector<char> buf(std::min(chunk_size, size()));
+				for(size_t i = 0, n = size(); i < n; i += chunk_size) {
+					auto k = std::min(chunk_size, n - i);
+					read(i, buf.data(), k);
+					f(static_cast<const char*>(buf.data()), k);
+				}
+			}
+
+			// fill from source: size_t(char* buf, size_t n) returning 0 at the end, returns bytes written
+			template<class S> size_t write_from(S source, size_t chunk_size = front::lob_chunk_size) {
+				std::vector<char> buf(chunk_size);
+				size_t offset = 0;
+				while (auto n = source(buf.data(), std::min(chunk_size, size() - offset))) {
+					write(offset, buf.data(), n);
+					offset += n;
+					if (offset == size()) break;
+				}
+				return offset;
+			}
+
+		private:
+			sqlite3* sq_;
+			sqlite3_blob* blob_;
+	};
+
+}}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef CPPSTDDB_SQLITE_CHECKPOINT_H
+#define CPPSTDDB_SQLITE_CHECKPOINT_H
+
+#include <cppstddb/sqlite/database.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sqlite3.h>
+
+/*
+   WAL checkpoints off the write path.  Attached connections are switched to
+   WAL mode with automatic checkpoints disabled, a wal hook records the log
+   size after each commit, and a background thread on its own connection
+   runs a passive checkpoint once the log passes a threshold (truncate once
+   it passes a larger one).  The committing thread only touches atomics.
+   A truncate checkpoint briefly holds the write lock, attached writers get
+   a busy timeout so they wait for it instead of failing.
+
+   The checkpointer must outlive its attached connections, or detach them.
+ */
+
+namespace cppstddb { namespace sqlite {
+
+	struct checkpoint_stats {
+		uint64_t checkpoints = 0;
+		uint64_t busy = 0;                // incomplete, readers or a writer in the way
+		int wal_pages = 0;                // log size at the last commit
+		int log_pages = 0;                // log size at the last checkpoint
+		int checkpointed_pages = 0;       // frames moved by the last checkpoint
+		std::chrono::microseconds last_latency{0};
+		std::chrono::microseconds max_latency{0};
+		std::chrono::microseconds total_latency{0};
+	};
+
+	class wal_checkpointer {
+		public:
+			using clock = std::chrono::steady_clock;
+
+			// thresholds are in wal pages, the thread also wakes every interval
+			wal_checkpointer(
+					const std::string& path,
+					int passive_pages = 1000,
+					int truncate_pages = 10000,
+					std::chrono::milliseconds interval = std::chrono::seconds(1),
+					std::chrono::milliseconds busy_timeout = std::chrono::seconds(5)):
+				path_(path),
+				passive_pages_(passive_pages),
+				truncate_pages_(truncate_pages),
+				interval_(interval),
+				busy_timeout_(busy_timeout),
+				wal_pages_(0),
+				pending_(false),
+				stop_(false),
+				sq_(impl::open(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_URI)) {
+					try {
+						exec("pragma journal_mode=wal");
+						sqlite3_wal_autocheckpoint(sq_, 0);
+						thread_ = std::thread([this] {run();});
+					} catch (...) {
+						// no destructor for a partly built object
+						sqlite3_close(sq_);
+						throw;
+					}
+				}
+
+			~wal_checkpointer() {
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					stop_ = true;
+				}
+				cv_.notify_all();
+				thread_.join();
+				impl::check_nothrow("sqlite3_close", sqlite3_close(sq_));
+			}
+
+			wal_checkpointer(const wal_checkpointer&) = delete;
+			wal_checkpointer& operator=(const wal_checkpointer&) = delete;
+
+			template<class C> void attach(C& con) {attach(con.data_->sq);}
+			template<class C> void detach(C& con) {detach(con.data_->sq);}
+
+			void attach(sqlite3* sq) {
+				DB_TRACE("wal_checkpointer: attach");
+				impl::check("pragma journal_mode", sq,
+						sqlite3_exec(sq, "pragma journal_mode=wal", nullptr, nullptr, nullptr));
+				sqlite3_busy_timeout(sq, busy_timeout_.count());
+				sqlite3_wal_autocheckpoint(sq, 0);
+				sqlite3_wal_hook(sq, hook, this);
+			}
+
+			// back to sqlite's default of checkpointing on commit
+			void detach(sqlite3* sq) {
+				DB_TRACE("wal_checkpointer: detach");
+				sqlite3_wal_autocheckpoint(sq, 1000);
+			}
+
+			// run a checkpoint now on the calling thread, true if the log was fully copied
+			bool checkpoint(int mode = SQLITE_CHECKPOINT_PASSIVE) {
+				std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+				int log = 0, done = 0;
+				auto start = clock::now();
+				int ret = sqlite3_wal_checkpoint_v2(sq_, nullptr, mode, &log, &done);
+				auto latency = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+
+				std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+				++stats_.checkpoints;
+				if (ret == SQLITE_BUSY || (ret == SQLITE_OK && done < log)) ++stats_.busy;
+				else if (ret != SQLITE_OK) DB_ERROR("sqlite3_wal_checkpoint_v2: " << ret << ": " << sqlite3_errmsg(sq_));
+				stats_.log_pages = log;
+				stats_.checkpointed_pages = done;
+				stats_.last_latency = latency;
+				if (latency > stats_.max_latency) stats_.max_latency = latency;
+				stats_.total_latency += latency;
+				DB_TRACE("wal checkpoint: mode " << mode << ", log " << log << ", done " << done
+						<< ", " << latency.count() << "us");
+				return ret == SQLITE_OK && done == log;
+			}
+
+			checkpoint_stats stats() const {
+				std::lock_guard<std::mutex> lock(stats_mutex_);
+				auto s = stats_;
+				s.wal_pages = wal_pages_.load();
+				return s;
+			}
+
+		private:
+			std::string path_;
+			int passive_pages_;
+			int truncate_pages_;
+			std::chrono::milliseconds interval_;
+			std::chrono::milliseconds busy_timeout_;
+			std::atomic<int> wal_pages_;
+			std::atomic<bool> pending_;
+			bool stop_;
+			sqlite3* sq_;
+
+			std::thread thread_;
+			std::mutex mutex_;
+			std::condition_variable cv_;
+			std::mutex checkpoint_mutex_;
+			mutable std::mutex stats_mutex_;
+			checkpoint_stats stats_;
+
+			void exec(const char* sql) {
+				impl::check(sql, sq_, sqlite3_exec(sq_, sql, nullptr, nullptr, nullptr));
+			}
+
+			// on the committing thread, keep it cheap
+			static int hook(void* p, sqlite3*, const char*, int pages) {
+				auto& self = *static_cast<wal_checkpointer*>(p);
+				self.wal_pages_ = pages;
+				if (pages >= self.passive_pages_ && !self.pending_.exchange(true)) {
+					self.cv_.notify_one();
+				}
+				return SQLITE_OK;
+			}
+
+			void run() {
+				std::unique_lock<std::mutex> lock(mutex_);
+				while (!stop_) {
+					cv_.wait_for(lock, interval_, [this] {return stop_ || pending_.load();});
+					if (stop_) break;
+					int pages = wal_pages_;
+					if (pages < passive_pages_) continue;
+					pending_ = false;
+					lock.unlock();
+					if (checkpoint(pages >= truncate_pages_ ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_PASSIVE)) {
+						// nothing left to do until the next commit
+						wal_pages_.compare_exchange_strong(pages, 0);
+					}
+					lock.lock();
+				}
+			}
+	};
+
+}}
+
+#endif
+
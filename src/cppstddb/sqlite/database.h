@@ -4,11 +4,15 @@
 #include <cppstddb/front.h>
 #include <cppstddb/util.h>
 #include <cppstddb/date_parse.h>
+#include <cppstddb/sqlite/function.h>
+#include <cppstddb/sqlite/vtab.h>
 #include <vector>
 #include <sstream>
 #include <sqlite3.h>
 //#include <sqlite3ext.h>
 #include <cstring>
+#include <cctype>
+#include <algorithm>
 
 namespace cppstddb { namespace sqlite {
 
@@ -20,6 +24,7 @@ namespace cppstddb { namespace sqlite {
 		template<class P> class rowset;
 		template<class P> class bind_type;
 		template<class P,class T> class field;
+		template<class P,class T> struct param;
 
 		template<class P> using cell_t = cppstddb::front::cell<database<P>>;
 
@@ -51,6 +56,26 @@ namespace cppstddb { namespace sqlite {
 			return ret;
 		}
 
+		inline error_kind error_kind_of(int code) {
+			switch(code) {
+				case SQLITE_CONSTRAINT_UNIQUE:
+				case SQLITE_CONSTRAINT_PRIMARYKEY: return error_kind::unique_violation;
+				case SQLITE_BUSY_SNAPSHOT: return error_kind::serialization_failure;
+			}
+			switch(code & 0xff) {
+				case SQLITE_BUSY:
+				case SQLITE_LOCKED: return error_kind::lock_timeout;
+			}
+			return error_kind::other;
+		}
+
+		// the connection's last error, the message is read when asked for
+		inline error make_error(const char* where, sqlite3* sq) {
+			int code = sqlite3_extended_errcode(sq);
+			return error(error_kind_of(code), where, code, nullptr,
+					[](const void* h) {return sqlite3_errmsg(static_cast<sqlite3*>(const_cast<void*>(h)));}, sq);
+		}
+
 		template<class S> int check_nothrow(const S& msg, int ret) {
 			if (is_error(ret)) {
 				std::stringstream s;
@@ -60,6 +85,70 @@ namespace cppstddb { namespace sqlite {
 			return ret;
 		}
 
+		// open a raw handle, for helper connections outside the front api
+		inline sqlite3* open(const std::string& filename, int flags) {
+			sqlite3* sq = nullptr;
+			int ret = sqlite3_open_v2(filename.c_str(), &sq, flags, nullptr);
+			if (is_error(ret)) {
+				std::string msg = sq ? sqlite3_errmsg(sq) : "out of memory";
+				sqlite3_close(sq);
+				throw database_error("sqlite3_open_v2: " + filename, ret, msg);
+			}
+			return sq;
+		}
+
+		/*
+		   uri options: journal_mode, synchronous, mmap_size and cache_size
+		   become pragmas, busy_timeout (ms), nomutex and fullmutex are applied on open,
+		   sqlite's own uri parameters (mode, cache, immutable, ...) are
+		   passed through in a uri filename
+		 */
+
+		inline bool is_uri_parameter(const std::string& key) {
+			return key == "vfs" || key == "mode" || key == "cache" ||
+				key == "psow" || key == "nolock" || key == "immutable";
+		}
+
+		inline bool is_pragma_option(const std::string& key) {
+			return key == "journal_mode" || key == "synchronous" ||
+				key == "mmap_size" || key == "cache_size";
+		}
+
+		inline std::string open_filename(const source& src) {
+			std::string path = src.server;
+			if (!src.database.empty()) path += "/" + src.database; // file:///abs/path
+
+			std::string query;
+			for(auto& o : src.options) {
+				if (!is_uri_parameter(o.first)) continue;
+				query += query.empty() ? '?' : '&';
+				query += o.first + "=" + (o.second.empty() ? "1" : o.second);
+			}
+			if (query.empty()) return path;
+
+			if (path.compare(0, 5, "file:") == 0) return path + query;
+			std::string uri = "file:";
+			for(char c : path) {
+				if (c == '?' || c == '#' || c == '%') {
+					static const char hex[] = "0123456789ABCDEF";
+					uri += '%';
+					uri += hex[static_cast<unsigned char>(c) >> 4];
+					uri += hex[c & 0xf];
+				} else uri += c;
+			}
+			return uri + query;
+		}
+
+		inline void apply_pragma(sqlite3* sq, const std::string& key, const std::string& value) {
+			// values end up in sql text, keep them to words and numbers
+			auto valid = !value.empty() && std::all_of(value.begin(), value.end(), [](char c) {
+					return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-';});
+			if (!valid) raise_error("sqlite: bad value for option " + key + ": " + value);
+			auto sql = "pragma " + key + "=" + value;
+			DB_TRACE("con: " << sql);
+			check(sql, sq, sqlite3_exec(sq, sql.c_str(), nullptr, nullptr, nullptr));
+		}
+
 		template<class P> class database {
 			public:
 				using policy_type = P;
@@ -69,6 +158,7 @@ namespace cppstddb { namespace sqlite {
 				using rowset = rowset<policy_type>;
 				using bind_type = bind_type<policy_type>;
 				template<typename T> using field_type = field<policy_type,T>;
+				template<typename T> using param_type = param<policy_type,T>;
 
                 string date_column_type() const {return "text";}
 
@@ -97,19 +187,127 @@ namespace cppstddb { namespace sqlite {
 					else if (src.protocol != "file")
 						raise_error("uri protocol must be file");
 
-					path = src.server;  // file is server for moment FIX
+					path = open_filename(src).c_str();
 
 					DB_TRACE("con: sqlite opening file: " << path);
 
-					int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+					// uri filenames allow shared-cache memory databases (see replica.h)
+					int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI;
+					if (src.option_bool("nomutex", false)) flags |= SQLITE_OPEN_NOMUTEX;
+					if (src.option_bool("fullmutex", false)) flags |= SQLITE_OPEN_FULLMUTEX;
 					check("sqlite3_open_v2", sq, sqlite3_open_v2(path.c_str(), &sq, flags, nullptr));
 
+					try {
+						for(auto& o : src.options) {
+							if (is_pragma_option(o.first)) {
+								apply_pragma(sq, o.first, o.second);
+							} else if (o.first == "busy_timeout") {
+								sqlite3_busy_timeout(sq, src.option_int(o.first, 0));
+							} else if (o.first != "nomutex" && o.first != "fullmutex" && !is_uri_parameter(o.first)) {
+								DB_WARN("sqlite: ignoring option " << o.first);
+							}
+						}
+					} catch (...) {
+						sqlite3_close(sq);
+						throw;
+					}
 				}
 
 				~connection() {
 					DB_TRACE("~con: sqlite closing " << path);
 					if (sq) check_nothrow("sqlite3_close", sqlite3_close(sq));
 				}
+
+				// sqlite3_interrupt is safe to call from another thread
+				void cancel() {
+					DB_TRACE("con: sqlite interrupt");
+					sqlite3_interrupt(sq);
+				}
+
+				// immediate: take the write lock now rather than fail to upgrade at the first write
+				void begin() {exec("begin immediate");}
+				void commit() {exec("commit");}
+				void rollback() {exec("rollback");}
+
+				void exec(const char* sql) {
+					DB_TRACE("exec: " << sql);
+					check(sql, sq, sqlite3_exec(sq, sql, nullptr, nullptr, nullptr));
+				}
+
+				// register f as a scalar sql function, arguments and result from its signature
+				template<class F> void create_function(const string& name, F f, int flags = SQLITE_UTF8) {
+					using function = scalar_function<F>;
+					DB_TRACE("create_function: " << name << ", args: " << function::arity);
+					check("sqlite3_create_function_v2", sq, sqlite3_create_function_v2(
+								sq,
+								name.c_str(),
+								function::arity,
+								flags,
+								new F(std::move(f)),
+								function::call,
+								nullptr,
+								nullptr,
+								destroy<F>));
+				}
+
+				// register an aggregate with state S: step void(S&, args...), final R(S&)
+				template<class S, class Step, class Final>
+					void create_aggregate(const string& name, Step step, Final final, int flags = SQLITE_UTF8) {
+						using function = aggregate_function<S,Step,Final>;
+						DB_TRACE("create_aggregate: " << name << ", args: " << function::arity);
+						check("sqlite3_create_function_v2", sq, sqlite3_create_function_v2(
+									sq,
+									name.c_str(),
+									function::arity,
+									flags,
+									new function(step, final, step),
+									nullptr,
+									function::step,
+									function::final,
+									destroy<function>));
+					}
+
+#if SQLITE_VERSION_NUMBER >= 3025000
+				// aggregate usable as a window function, inverse undoes a step
+				template<class S, class Step, class Inverse, class Final>
+					void create_window_function(
+							const string& name,
+							Step step,
+							Inverse inverse,
+							Final final,
+							int flags = SQLITE_UTF8) {
+						using function = aggregate_function<S,Step,Final,Inverse>;
+						DB_TRACE("create_window_function: " << name << ", args: " << function::arity);
+						check("sqlite3_create_window_function", sq, sqlite3_create_window_function(
+									sq,
+									name.c_str(),
+									function::arity,
+									flags,
+									new function(step, final, inverse),
+									function::step,
+									function::final,
+									function::value,
+									function::inverse,
+									destroy<function>));
+					}
+#endif
+
+				/*
+				   expose a container as the eponymous virtual table name, columns
+				   from column("name", &row::member [, key]); the container is
+				   referenced, not copied
+				 */
+				template<class C, class... Columns>
+					void create_module(const string& name, const C& container, Columns... columns) {
+						using module = container_module<C>;
+						DB_TRACE("create_module: " << name);
+						check("sqlite3_create_module_v2", sq, sqlite3_create_module_v2(
+									sq,
+									name.c_str(),
+									module::sqlite_module(),
+									new module(container, {columns...}),
+									destroy<module>));
+					}
 		};
 
 		template<class P> class statement {
@@ -135,7 +333,7 @@ namespace cppstddb { namespace sqlite {
 			public:
 				statement(connection& con_, const string& sql_):
 					con(con_),
-					sql(sql_),
+					sql(sql_, policy_type::template get_allocator<char>()),
 					sq(con_.sq),
 					state(state_init),
 					st(nullptr),
@@ -146,7 +344,8 @@ namespace cppstddb { namespace sqlite {
 
 				~statement() {
 					DB_TRACE("~stmt");
-					if (st) check_nothrow("sqlite3_finalize", sqlite3_finalize(st));
+					// finalize only repeats the error of a failed step, already raised or returned
+					if (st) sqlite3_finalize(st);
 				}
 
 				void prepare() {
@@ -162,8 +361,17 @@ namespace cppstddb { namespace sqlite {
 					}
 				}
 
+				// preparing is local, there is no round trip to skip
+				void prepare_direct() {prepare();}
+
 				statement& query() {
-					if (state == state_execute) return *this;
+					error e;
+					if (!try_query(e)) e.raise();
+					return *this;
+				}
+
+				bool try_query(error& e) {
+					if (state == state_execute) return true;
 					state = state_execute;
 					int status = sqlite3_step(st);
 					DB_TRACE("sqlite3_step: status: " << status);
@@ -172,16 +380,25 @@ namespace cppstddb { namespace sqlite {
 					} else if (status == SQLITE_DONE) {
 						reset();
 					} else {
-						//raise_error(sq, "step error", status);
-						raise_error("step error", status);
+						e = make_error("step error", sq);
+						return false;
 					}
-					return *this;
+					return true;
 				}
 
 				void reset() {
 					check("sqlite3_reset", sqlite3_reset(st));
 				}
 
+				// before binding parameters for another execution, reset
+				// returns the error of a failed step again, it was already raised
+				void begin_bind() {
+					if (state != state_execute) return;
+					sqlite3_reset(st);
+					state = state_init;
+					has_rows = false;
+				}
+
 
 		};
 
@@ -204,7 +421,7 @@ namespace cppstddb { namespace sqlite {
 				int status;
 
 				// artifical bind array (for now)
-				using bind_vector = std::vector<bind_type>;
+				using bind_vector = typename policy_type::template vector<bind_type>;
 				bind_vector binds;
 
 
@@ -213,51 +430,135 @@ namespace cppstddb { namespace sqlite {
 					stmt(stmt_),
 					st(stmt.st),
 					columns(sqlite3_column_count(st)),
-					status(SQLITE_OK) {
+					status(SQLITE_OK),
+					binds(policy_type::template get_allocator<bind_type>()) {
 						DB_TRACE("rowset" << ", columns: " << columns);
 
-						// artificial bind setup
 						binds.reserve(columns);
 						for(int i = 0; i < columns; ++i) {
 							binds.push_back(bind_type());
 							auto& b = binds.back();
-							b.type = value_string;
+							b.type = column_value_type(i);
 							b.idx = i;
-							//DB_TRACE("bind: idx: " << b.idx << ", type: " << b.type);
+							DB_TRACE("bind: idx: " << b.idx << ", type: " << b.type);
 						}
 
 					}
 
+				/*
+				   declared type affinity (sqlite's rules), or for expressions
+				   the storage class of the first row; text when neither helps
+				 */
+				value_type column_value_type(int col) const {
+					auto decl = sqlite3_column_decltype(st, col);
+					if (decl) {
+						std::string d(decl);
+						for(auto& c : d) c = toupper(static_cast<unsigned char>(c));
+						if (d.find("INT") != std::string::npos) return value_int64;
+						if (d.find("CHAR") != std::string::npos ||
+								d.find("CLOB") != std::string::npos ||
+								d.find("TEXT") != std::string::npos) return value_string;
+						if (d.empty() || d.find("BLOB") != std::string::npos) return value_blob;
+						if (d.find("REAL") != std::string::npos ||
+								d.find("FLOA") != std::string::npos ||
+								d.find("DOUB") != std::string::npos) return value_double;
+						return value_string; // numeric affinity, values may be either
+					}
+					if (stmt.has_rows) {
+						switch(sqlite3_column_type(st, col)) {
+							case SQLITE_INTEGER: return value_int64;
+							case SQLITE_FLOAT: return value_double;
+							case SQLITE_BLOB: return value_blob;
+						}
+					}
+					return value_string;
+				}
+
 				//bool hasResult() {return result_metadata != null;}
 
 				int fetch() {
 					// step already done by execute
-					return 1; // check
+					return stmt.has_rows ? 1 : 0;
 				}
 
 				int next() {
+					error e;
+					int n = try_next(e);
+					if (e) e.raise();
+					return n;
+				}
+
+				int try_next(error& e) {
 					status = sqlite3_step(st);
 					if (status == SQLITE_ROW) return 1;
 					if (status == SQLITE_DONE) {
 						stmt.reset();
 						return 0;
 					}
-					raise_error("sqlite3_step", status);
+					e = make_error("sqlite3_step", stmt.sq);
 					return 0;
 				}
 
+				bool is_null(int col) const {return sqlite3_column_type(st, col) == SQLITE_NULL;}
+
+				// storage class of the current row (columns are not typed in sqlite)
+				value_type row_type(int col) const {
+					switch(sqlite3_column_type(st, col)) {
+						case SQLITE_INTEGER: return value_int64;
+						case SQLITE_FLOAT: return value_double;
+						case SQLITE_BLOB: return value_blob;
+						case SQLITE_TEXT: return value_string;
+					}
+					return binds[col].type;
+				}
+
+				// the value is already in sqlite's row buffer, hand it out in slices
+				template<class F> void read_chunks(int col, F f, size_t chunk) const {
+					auto p = binds[col].type == value_blob ?
+						static_cast<const char*>(sqlite3_column_blob(st, col)) :
+						reinterpret_cast<const char*>(sqlite3_column_text(st, col));
+					size_t n = sqlite3_column_bytes(st, col);
+					for(size_t i = 0; i < n; i += chunk) f(p + i, std::min(chunk, n - i));
+				}
+
 				auto name(size_t idx) {
 					auto ptr = sqlite3_column_name(st, idx);
-					return string(ptr,strlen(ptr));
+					return make_string<policy_type,string>(ptr,strlen(ptr));
 				}
 		};
 
 		template<class P, typename T> struct field {};
 
-		template<class P> struct field<P,std::string> {
-			static std::string as(const rowset<P>& r, const cell_t<P>& cell) {
+		template<class P, class A> struct field<P,std::basic_string<char,std::char_traits<char>,A>> {
+			using string = std::basic_string<char,std::char_traits<char>,A>;
+			static string as(const rowset<P>& r, const cell_t<P>& cell) {
 				auto ptr = reinterpret_cast<const char*>(sqlite3_column_text(r.st, cell.bind_.idx));
-				return std::string(ptr,strlen(ptr));
+				return make_string<P,string>(ptr, sqlite3_column_bytes(r.st, cell.bind_.idx));
+			}
+		};
+
+		template<class P> struct field<P,std::experimental::string_view> {
+			static std::experimental::string_view as(const rowset<P>& r, const cell_t<P>& cell) {
+				auto idx = cell.bind_.idx;
+				// blobs as is, anything else converted to text by sqlite
+				auto ptr = cell.bind_.type == value_blob ?
+					static_cast<const char*>(sqlite3_column_blob(r.st, idx)) :
+					reinterpret_cast<const char*>(sqlite3_column_text(r.st, idx));
+				return std::experimental::string_view(ptr, sqlite3_column_bytes(r.st, idx));
+			}
+		};
+
+		template<class P, class A> struct field<P,std::vector<unsigned char,A>> {
+			using blob = std::vector<unsigned char,A>;
+			static blob as(const rowset<P>& r, const cell_t<P>& cell) {
+				auto idx = cell.bind_.idx;
+				auto ptr = static_cast<const unsigned char*>(sqlite3_column_blob(r.st, idx));
+				auto n = sqlite3_column_bytes(r.st, idx);
+				if constexpr (std::is_same<A, typename P::template allocator<unsigned char>>::value) {
+					return blob(ptr, ptr + n, P::template get_allocator<unsigned char>());
+				} else {
+					return blob(ptr, ptr + n);
+				}
 			}
 		};
 
@@ -267,6 +568,24 @@ namespace cppstddb { namespace sqlite {
 			}
 		};
 
+		template<class P> struct field<P,long> {
+			static long as(const rowset<P>& r, const cell_t<P>& cell) {
+				return sqlite3_column_int64(r.st, cell.bind_.idx);
+			}
+		};
+
+		template<class P> struct field<P,long long> {
+			static long long as(const rowset<P>& r, const cell_t<P>& cell) {
+				return sqlite3_column_int64(r.st, cell.bind_.idx);
+			}
+		};
+
+		template<class P> struct field<P,double> {
+			static double as(const rowset<P>& r, const cell_t<P>& cell) {
+				return sqlite3_column_double(r.st, cell.bind_.idx);
+			}
+		};
+
 		template<class P> struct field<P,date_t> {
 			static date_t as(const rowset<P>& r, const cell_t<P>& cell) {
 				auto ptr = reinterpret_cast<const char*>(sqlite3_column_text(r.st, cell.bind_.idx));
@@ -275,15 +594,98 @@ namespace cppstddb { namespace sqlite {
 			}
 		};
 
+		/*
+		   parameter encoders (idx is 0 based), sqlite copies text and blobs
+		   so values need not outlive the call
+		 */
+
+		template<class P, typename T> struct param {};
+
+		inline void check_bind(sqlite3* sq, int ret) {
+			if (is_error(ret)) raise_error("sqlite3_bind", sq, ret);
+		}
+
+		template<class P> struct param<P,int> {
+			static void bind(statement<P>& s, int idx, int v) {
+				check_bind(s.sq, sqlite3_bind_int(s.st, idx + 1, v));
+			}
+		};
+
+		template<class P> struct param<P,long> {
+			static void bind(statement<P>& s, int idx, long v) {
+				check_bind(s.sq, sqlite3_bind_int64(s.st, idx + 1, v));
+			}
+		};
+
+		template<class P> struct param<P,long long> {
+			static void bind(statement<P>& s, int idx, long long v) {
+				check_bind(s.sq, sqlite3_bind_int64(s.st, idx + 1, v));
+			}
+		};
+
+		template<class P> struct param<P,double> {
+			static void bind(statement<P>& s, int idx, double v) {
+				check_bind(s.sq, sqlite3_bind_double(s.st, idx + 1, v));
+			}
+		};
+
+		template<class P> struct param<P,std::experimental::string_view> {
+			static void bind(statement<P>& s, int idx, std::experimental::string_view v) {
+				check_bind(s.sq, sqlite3_bind_text(s.st, idx + 1, v.data(), v.size(), SQLITE_TRANSIENT));
+			}
+		};
+
+		template<class P, class A> struct param<P,std::basic_string<char,std::char_traits<char>,A>> {
+			static void bind(statement<P>& s, int idx, const std::basic_string<char,std::char_traits<char>,A>& v) {
+				check_bind(s.sq, sqlite3_bind_text(s.st, idx + 1, v.data(), v.size(), SQLITE_TRANSIENT));
+			}
+		};
+
+		template<class P, class A> struct param<P,std::vector<unsigned char,A>> {
+			static void bind(statement<P>& s, int idx, const std::vector<unsigned char,A>& v) {
+				check_bind(s.sq, sqlite3_bind_blob(s.st, idx + 1, v.data(), v.size(), SQLITE_TRANSIENT));
+			}
+		};
+
+		template<class P> struct param<P,std::nullptr_t> {
+			static void bind(statement<P>& s, int idx, std::nullptr_t) {
+				check_bind(s.sq, sqlite3_bind_null(s.st, idx + 1));
+			}
+		};
+
 	}
 
 
-	using database = cppstddb::front::basic_database<impl::database<default_policy>>;
+	template<class P> using basic_database = cppstddb::front::basic_database<impl::database<P>>;
+	using database = basic_database<default_policy>;
 
 	inline auto create_database() {
 		return database();
 	}
 
+	template<class F> void create_function(database::connection_t con, const std::string& name, F f) {
+		con.data_->create_function(name, std::move(f));
+	}
+
+	template<class S, class Step, class Final>
+		void create_aggregate(database::connection_t con, const std::string& name, Step step, Final final) {
+			con.data_->template create_aggregate<S>(name, step, final);
+		}
+
+#if SQLITE_VERSION_NUMBER >= 3025000
+	template<class S, class Step, class Inverse, class Final>
+		void create_window_function(database::connection_t con, const std::string& name, Step step, Inverse inverse, Final final) {
+			con.data_->template create_window_function<S>(name, step, inverse, final);
+		}
+#endif
+
+	using impl::column;
+
+	template<class C, class... Columns>
+		void create_module(database::connection_t con, const std::string& name, const C& container, Columns... columns) {
+			con.data_->create_module(name, container, columns...);
+		}
+
 
 }}
 
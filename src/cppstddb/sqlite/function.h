@@ -0,0 +1,215 @@
+#ifndef CPPSTDDB_SQLITE_FUNCTION_H
+#define CPPSTDDB_SQLITE_FUNCTION_H
+
+#include <experimental/string_view>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <optional>
+#include <exception>
+#include <type_traits>
+#include <sqlite3.h>
+
+/*
+   Support for registering C++ callables as sqlite SQL functions.  Argument
+   and result conversions are picked at compile time from the callable's
+   signature, text and blob arguments can be taken as string_view to read
+   sqlite's buffer without copying.
+ */
+
+namespace cppstddb { namespace sqlite { namespace impl {
+
+	template<class T> struct function_traits : function_traits<decltype(&T::operator())> {};
+
+	template<class R, class... A> struct function_traits<R (*)(A...)> {
+		using result = R;
+		using args = std::tuple<A...>;
+		static const int arity = sizeof...(A);
+	};
+
+	template<class C, class R, class... A> struct function_traits<R (C::*)(A...)> : function_traits<R (*)(A...)> {};
+	template<class C, class R, class... A> struct function_traits<R (C::*)(A...) const> : function_traits<R (*)(A...)> {};
+
+	template<class T> struct tag {};
+
+	// ---- sqlite3_value to C++
+
+	template<class T> typename std::enable_if<std::is_integral<T>::value, T>::type
+		from_value(sqlite3_value* v, tag<T>) {
+			return static_cast<T>(sqlite3_value_int64(v));
+		}
+
+	template<class T> typename std::enable_if<std::is_floating_point<T>::value, T>::type
+		from_value(sqlite3_value* v, tag<T>) {
+			return static_cast<T>(sqlite3_value_double(v));
+		}
+
+	inline std::experimental::string_view from_value(sqlite3_value* v, tag<std::experimental::string_view>) {
+		auto p = reinterpret_cast<const char*>(sqlite3_value_text(v));
+		if (!p) return std::experimental::string_view();
+		return std::experimental::string_view(p, sqlite3_value_bytes(v));
+	}
+
+	template<class A> auto from_value(sqlite3_value* v, tag<std::basic_string<char,std::char_traits<char>,A>>) {
+		auto s = from_value(v, tag<std::experimental::string_view>());
+		return std::basic_string<char,std::char_traits<char>,A>(s.data(), s.size());
+	}
+
+	inline sqlite3_value* from_value(sqlite3_value* v, tag<sqlite3_value*>) {return v;}
+
+	template<class T> std::optional<T> from_value(sqlite3_value* v, tag<std::optional<T>>) {
+		if (sqlite3_value_type(v) == SQLITE_NULL) return std::nullopt;
+		return from_value(v, tag<T>());
+	}
+
+	// ---- C++ to sqlite3 result
+
+	template<class T> typename std::enable_if<std::is_integral<T>::value>::type
+		set_result(sqlite3_context* ctx, T v) {
+			sqlite3_result_int64(ctx, v);
+		}
+
+	template<class T> typename std::enable_if<std::is_floating_point<T>::value>::type
+		set_result(sqlite3_context* ctx, T v) {
+			sqlite3_result_double(ctx, v);
+		}
+
+	inline void set_result(sqlite3_context* ctx, std::experimental::string_view s) {
+		sqlite3_result_text(ctx, s.data(), s.size(), SQLITE_TRANSIENT);
+	}
+
+	template<class A> void set_result(sqlite3_context* ctx, const std::basic_string<char,std::char_traits<char>,A>& s) {
+		sqlite3_result_text(ctx, s.data(), s.size(), SQLITE_TRANSIENT);
+	}
+
+	inline void set_result(sqlite3_context* ctx, const char* s) {
+		if (s) sqlite3_result_text(ctx, s, -1, SQLITE_TRANSIENT);
+		else sqlite3_result_null(ctx);
+	}
+
+	inline void set_result(sqlite3_context* ctx, std::nullptr_t) {sqlite3_result_null(ctx);}
+
+	template<class T> void set_result(sqlite3_context* ctx, const std::optional<T>& v) {
+		if (v) set_result(ctx, *v);
+		else sqlite3_result_null(ctx);
+	}
+
+	// ---- invocation
+
+	template<class F, class... A, size_t... I>
+		decltype(auto) invoke(F& f, sqlite3_value** argv, std::tuple<A...>*, std::index_sequence<I...>) {
+			return f(from_value(argv[I], tag<typename std::decay<A>::type>())...);
+		}
+
+	// aggregate steps take the state first, the sql arguments follow
+	template<class F, class S, class First, class... A, size_t... I>
+		void invoke_step(F& f, S& state, sqlite3_value** argv, std::tuple<First, A...>*, std::index_sequence<I...>) {
+			f(state, from_value(argv[I], tag<typename std::decay<A>::type>())...);
+		}
+
+	template<class F, class... A> void call_and_set(sqlite3_context* ctx, F& f, A&&... a) {
+		using result = decltype(f(std::forward<A>(a)...));
+		if constexpr (std::is_void<result>::value) {
+			f(std::forward<A>(a)...);
+			sqlite3_result_null(ctx);
+		} else {
+			set_result(ctx, f(std::forward<A>(a)...));
+		}
+	}
+
+	template<class F> void destroy(void* p) {delete static_cast<F*>(p);}
+
+	template<class F> struct scalar_function {
+		using traits = function_traits<F>;
+		using args = typename traits::args;
+		static const int arity = traits::arity;
+
+		static void call(sqlite3_context* ctx, int, sqlite3_value** argv) {
+			auto& f = *static_cast<F*>(sqlite3_user_data(ctx));
+			try {
+				auto g = [&]() -> decltype(auto) {
+					return invoke(f, argv, static_cast<args*>(nullptr), std::make_index_sequence<arity>());
+				};
+				call_and_set(ctx, g);
+			} catch (std::exception& e) {
+				sqlite3_result_error(ctx, e.what(), -1);
+			}
+		}
+	};
+
+	/*
+	   aggregate state S lives on the heap, its pointer is kept in the
+	   sqlite aggregate context; step is void(S&, args...), final is R(S&),
+	   inverse (window functions) has the same form as step
+	 */
+
+	template<class S, class Step, class Final, class Inverse = Step> struct aggregate_function {
+		using traits = function_traits<Step>;
+		using args = typename traits::args;
+		static const int arity = traits::arity - 1;
+
+		Step step_;
+		Final final_;
+		Inverse inverse_;
+
+		aggregate_function(Step s, Final f, Inverse i):step_(s),final_(f),inverse_(i) {}
+
+		static aggregate_function& self(sqlite3_context* ctx) {
+			return *static_cast<aggregate_function*>(sqlite3_user_data(ctx));
+		}
+
+		// the state pointer, zero before the first step
+		static S** slot(sqlite3_context* ctx, bool create) {
+			return static_cast<S**>(sqlite3_aggregate_context(ctx, create ? sizeof(S*) : 0));
+		}
+
+		template<class G> static void apply(sqlite3_context* ctx, G& g, sqlite3_value** argv) {
+			try {
+				auto p = slot(ctx, true);
+				if (!p) {
+					sqlite3_result_error_nomem(ctx);
+					return;
+				}
+				if (!*p) *p = new S();
+				invoke_step(g, **p, argv, static_cast<args*>(nullptr), std::make_index_sequence<arity>());
+			} catch (std::exception& e) {
+				sqlite3_result_error(ctx, e.what(), -1);
+			}
+		}
+
+		static void step(sqlite3_context* ctx, int, sqlite3_value** argv) {
+			apply(ctx, self(ctx).step_, argv);
+		}
+
+		static void inverse(sqlite3_context* ctx, int, sqlite3_value** argv) {
+			apply(ctx, self(ctx).inverse_, argv);
+		}
+
+		static void value(sqlite3_context* ctx) {
+			auto p = slot(ctx, false);
+			try {
+				if (p && *p) {
+					call_and_set(ctx, self(ctx).final_, **p);
+				} else {
+					S empty{};
+					call_and_set(ctx, self(ctx).final_, empty);
+				}
+			} catch (std::exception& e) {
+				sqlite3_result_error(ctx, e.what(), -1);
+			}
+		}
+
+		static void final(sqlite3_context* ctx) {
+			value(ctx);
+			auto p = slot(ctx, false);
+			if (p && *p) {
+				delete *p;
+				*p = nullptr;
+			}
+		}
+	};
+
+}}}
+
+#endif
+
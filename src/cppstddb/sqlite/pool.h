@@ -0,0 +1,152 @@
+#ifndef CPPSTDDB_SQLITE_POOL_H
+#define CPPSTDDB_SQLITE_POOL_H
+
+#include <cppstddb/sqlite/database.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+   Concurrent readers for one database file.  The pool opens N read only
+   WAL connections and one writer, so reads on different threads never
+   serialize on a shared connection.  A thread goes back to the reader it
+   used last when that one is free, keeping its statement and page caches
+   warm.  Writes are serialized on the writer.
+
+   Readers keep sqlite's connection mutex (uncontended while leased): a
+   lease hands out a connection handle, and copies of it or of its
+   statements may still be used after the lease is released.
+ */
+
+namespace cppstddb { namespace sqlite {
+
+	template<class D = database> class read_pool {
+		public:
+			using database_type = D;
+			using connection_t = typename database_type::connection_t;
+
+			class lease {
+				public:
+					lease(lease&& other):
+						pool_(other.pool_),
+						slot_(other.slot_),
+						con_(other.con_),
+						write_lock_(std::move(other.write_lock_)) {
+							other.pool_ = nullptr;
+						}
+
+					~lease() {
+						if (pool_ && slot_ >= 0) pool_->release(slot_);
+					}
+
+					lease(const lease&) = delete;
+					lease& operator=(const lease&) = delete;
+					lease& operator=(lease&&) = delete;
+
+					connection_t& operator*() {return *con_;}
+					connection_t* operator->() {return con_;}
+
+				private:
+					friend class read_pool;
+					read_pool* pool_;
+					int slot_; // -1 for the writer
+					connection_t* con_;
+					std::unique_lock<std::mutex> write_lock_;
+
+					lease(read_pool* pool, int slot, connection_t* con):
+						pool_(pool), slot_(slot), con_(con) {}
+
+					lease(read_pool* pool, connection_t* con, std::unique_lock<std::mutex> lock):
+						pool_(pool), slot_(-1), con_(con), write_lock_(std::move(lock)) {}
+			};
+
+			read_pool(const std::string& uri, int readers = std::thread::hardware_concurrency()):
+				id_(next_id()),
+				db_(uri),
+				writer_(db_.connection(with_options(uri, "journal_mode=wal"))),
+				busy_(new std::atomic<bool>[std::max(readers, 1)]),
+				waiters_(0) {
+					readers = std::max(readers, 1);
+					readers_.reserve(readers);
+					for(int i = 0; i != readers; ++i) {
+						readers_.push_back(db_.connection(with_options(uri, "mode=ro&fullmutex")));
+						busy_[i] = false;
+					}
+				}
+
+			read_pool(const read_pool&) = delete;
+			read_pool& operator=(const read_pool&) = delete;
+
+			int size() const {return readers_.size();}
+
+			// a read only connection for this thread, blocks while all are leased
+			lease reader() {
+				int slot = try_acquire();
+				if (slot < 0) {
+					std::unique_lock<std::mutex> lock(mutex_);
+					++waiters_;
+					while ((slot = try_acquire()) < 0) cv_.wait(lock);
+					--waiters_;
+				}
+				last() = std::make_pair(id_, slot);
+				return lease(this, slot, &readers_[slot]);
+			}
+
+			// the writer connection, held exclusively for the lease lifetime
+			lease writer() {
+				return lease(this, &writer_, std::unique_lock<std::mutex>(write_mutex_));
+			}
+
+		private:
+			uint64_t id_; // for the thread's last reader, a later pool may reuse the address
+			database_type db_;
+			connection_t writer_;
+			std::vector<connection_t> readers_;
+			std::unique_ptr<std::atomic<bool>[]> busy_;
+			std::atomic<int> waiters_;
+			std::mutex mutex_;
+			std::condition_variable cv_;
+			std::mutex write_mutex_;
+
+			static std::string with_options(const std::string& uri, const char* options) {
+				return uri + (uri.find('?') == std::string::npos ? "?" : "&") + options;
+			}
+
+			static uint64_t next_id() {
+				static std::atomic<uint64_t> id(0);
+				return ++id;
+			}
+
+			static std::pair<uint64_t,int>& last() {
+				static thread_local std::pair<uint64_t,int> slot(0, 0);
+				return slot;
+			}
+
+			bool acquire(int slot) {
+				return !busy_[slot].load(std::memory_order_relaxed) && !busy_[slot].exchange(true);
+			}
+
+			int try_acquire() {
+				auto& l = last();
+				if (l.first == id_ && acquire(l.second)) return l.second;
+				for(int i = 0; i != size(); ++i) if (acquire(i)) return i;
+				return -1;
+			}
+
+			void release(int slot) {
+				busy_[slot] = false;
+				if (waiters_) {
+					std::lock_guard<std::mutex> lock(mutex_);
+					cv_.notify_one();
+				}
+			}
+	};
+
+}}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef CPPSTDDB_SQLITE_REPLICA_H
+#define CPPSTDDB_SQLITE_REPLICA_H
+
+#include <cppstddb/sqlite/database.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sqlite3.h>
+
+/*
+   An in-memory copy of a database file for read heavy services.  The file
+   is loaded into a named shared-cache memory database with the backup api,
+   connections opened on uri() then never touch the file or the os page
+   cache.  refresh() loads a fresh snapshot into a new memory database and
+   swaps it in: connections opened afterwards see the new snapshot, open
+   connections keep the one they started with until they close.  Changes
+   made to the replica can be written back explicitly or periodically.
+ */
+
+namespace cppstddb { namespace sqlite {
+
+	namespace impl {
+
+		// copy main of src into main of dst, pages < 0 copies in one step
+		inline void backup(sqlite3* dst, sqlite3* src, int pages = -1) {
+			auto b = sqlite3_backup_init(dst, "main", src, "main");
+			if (!b) raise_error("sqlite3_backup_init", dst, sqlite3_errcode(dst));
+			int ret;
+			while ((ret = sqlite3_backup_step(b, pages)) != SQLITE_DONE) {
+				if (ret == SQLITE_BUSY || ret == SQLITE_LOCKED) {
+					sqlite3_sleep(1);
+				} else if (ret != SQLITE_OK) {
+					sqlite3_backup_finish(b);
+					raise_error("sqlite3_backup_step", dst, ret);
+				}
+			}
+			check("sqlite3_backup_finish", dst, sqlite3_backup_finish(b));
+		}
+
+	}
+
+	class memory_replica {
+		public:
+			memory_replica(const std::string& path):
+				path_(path),
+				id_(next_id()),
+				generation_(0),
+				anchor_(nullptr),
+				stop_(false) {
+					anchor_ = load();
+				}
+
+			~memory_replica() {
+				stop_write_back();
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (anchor_) impl::check_nothrow("sqlite3_close", sqlite3_close(anchor_));
+			}
+
+			memory_replica(const memory_replica&) = delete;
+			memory_replica& operator=(const memory_replica&) = delete;
+
+			// connection uri of the current snapshot, e.g. db.connection(r.uri())
+			std::string uri() const {
+				std::lock_guard<std::mutex> lock(mutex_);
+				return "file://" + filename(generation_);
+			}
+
+			const std::string& path() const {return path_;}
+
+			// load a fresh snapshot of the file and make it current
+			void refresh() {
+				std::lock_guard<std::mutex> lock(mutex_);
+				auto sq = load(generation_ + 1);
+				// the old memory database is freed when its last connection closes
+				impl::check_nothrow("sqlite3_close", sqlite3_close(anchor_));
+				anchor_ = sq;
+				++generation_;
+			}
+
+			// copy the current snapshot back to the file (or to another path)
+			void write_back() {write_back(path_);}
+
+			void write_back(const std::string& path) {
+				std::lock_guard<std::mutex> lock(mutex_);
+				DB_TRACE("memory_replica: write back to " << path);
+				auto sq = impl::open(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+				try {
+					impl::backup(sq, anchor_);
+				} catch (...) {
+					sqlite3_close(sq);
+					throw;
+				}
+				impl::check_nothrow("sqlite3_close", sqlite3_close(sq));
+			}
+
+			// write back from a background thread every interval until stopped
+			template<class Rep, class Period>
+				void write_back_every(std::chrono::duration<Rep,Period> interval) {
+					stop_write_back();
+					stop_ = false;
+					writer_ = std::thread([this, interval] {
+							std::unique_lock<std::mutex> lock(wait_mutex_);
+							while (!cv_.wait_for(lock, interval, [this] {return stop_.load();})) {
+								try {
+									write_back();
+								} catch (database_error& e) {
+									DB_ERROR("memory_replica: write back failed: " << e.what());
+								}
+							}
+						});
+				}
+
+			void stop_write_back() {
+				if (!writer_.joinable()) return;
+				{
+					std::lock_guard<std::mutex> lock(wait_mutex_);
+					stop_ = true;
+				}
+				cv_.notify_all();
+				writer_.join();
+			}
+
+		private:
+			std::string path_;
+			unsigned id_;
+			unsigned generation_;
+			sqlite3* anchor_; // keeps the current memory database alive
+			mutable std::mutex mutex_;
+
+			std::thread writer_;
+			std::mutex wait_mutex_;
+			std::condition_variable cv_;
+			std::atomic<bool> stop_;
+
+			static unsigned next_id() {
+				static std::atomic<unsigned> id(0);
+				return id++;
+			}
+
+			std::string filename(unsigned generation) const {
+				return "file:cppstddb_replica_" + std::to_string(id_) + "_" +
+					std::to_string(generation) + "?mode=memory&cache=shared";
+			}
+
+			sqlite3* load(unsigned generation = 0) {
+				DB_TRACE("memory_replica: loading " << path_ << " as " << filename(generation));
+				auto src = impl::open(path_, SQLITE_OPEN_READONLY);
+				sqlite3* sq = nullptr;
+				try {
+					sq = impl::open(
+							filename(generation),
+							SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI);
+					impl::backup(sq, src);
+				} catch (...) {
+					sqlite3_close(sq);
+					sqlite3_close(src);
+					throw;
+				}
+				impl::check_nothrow("sqlite3_close", sqlite3_close(src));
+				return sq;
+			}
+	};
+
+}}
+
+#endif
+
@@ -0,0 +1,312 @@
+#ifndef CPPSTDDB_SQLITE_VTAB_H
+#define CPPSTDDB_SQLITE_VTAB_H
+
+#include <cppstddb/sqlite/function.h>
+#include <algorithm>
+#include <iterator>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <sqlite3.h>
+
+/*
+   Expose a C++ container as an eponymous sqlite virtual table so it can be
+   joined with regular tables without copying it in.  The container is
+   referenced, not copied, and must outlive the connection (or be replaced
+   before it changes).  One column may be declared as the key: the container
+   must then be sorted ascending on it, and equality and range constraints
+   on that column are answered with a binary search.  The search only
+   narrows the scan, sqlite still checks each constraint, and it is skipped
+   for a value of another type than the key (k > 2.5 on an integer key) or a
+   text key under a collation other than binary.
+ */
+
+namespace cppstddb { namespace sqlite { namespace impl {
+
+	template<class Row> struct column_def {
+		std::string name;
+		std::string type;
+		int storage; // sqlite type of the values
+		bool key;
+		std::function<void(sqlite3_context*, const Row&)> result;
+		std::function<int(const Row&, sqlite3_value*)> compare; // row <=> value
+	};
+
+	template<class T> const char* column_type(tag<T>) {
+		return std::is_integral<T>::value ? "integer" : std::is_floating_point<T>::value ? "real" : "text";
+	}
+
+	template<class T> int column_storage(tag<T>) {
+		return std::is_integral<T>::value ? SQLITE_INTEGER : std::is_floating_point<T>::value ? SQLITE_FLOAT : SQLITE_TEXT;
+	}
+
+	template<class T> const T& key_view(const T& v) {return v;}
+
+	template<class A> std::experimental::string_view key_view(const std::basic_string<char,std::char_traits<char>,A>& v) {
+		return std::experimental::string_view(v.data(), v.size());
+	}
+
+	// keys compare as sqlite's int64 or double, a wider value is never narrowed to the key
+	template<class T> struct key_type {
+		using type = typename std::conditional<std::is_integral<T>::value, int64_t,
+			typename std::conditional<std::is_floating_point<T>::value, double, T>::type>::type;
+	};
+	template<class A> struct key_type<std::basic_string<char,std::char_traits<char>,A>> {
+		using type = std::experimental::string_view;
+	};
+
+	template<class Row, class T> column_def<Row> column(const std::string& name, T Row::* member, bool key = false) {
+		column_def<Row> c;
+		c.name = name;
+		c.type = column_type(tag<T>());
+		c.storage = column_storage(tag<T>());
+		c.key = key;
+		c.result = [member](sqlite3_context* ctx, const Row& row) {set_result(ctx, row.*member);};
+		c.compare = [member](const Row& row, sqlite3_value* v) {
+			typename key_type<T>::type a = key_view(row.*member);
+			auto b = from_value(v, tag<typename key_type<T>::type>());
+			return a < b ? -1 : b < a ? 1 : 0;
+		};
+		return c;
+	}
+
+	template<class C> class container_module {
+		public:
+			using container_type = C;
+			using row_type = typename container_type::value_type;
+			using iterator = typename container_type::const_iterator;
+			using column_type = column_def<row_type>;
+
+			// idxNum bits passed from xBestIndex to xFilter
+			enum {
+				plan_eq = 1,
+				plan_lower = 2,
+				plan_lower_strict = 4,
+				plan_upper = 8,
+				plan_upper_strict = 16,
+			};
+
+			struct table : sqlite3_vtab {
+				container_module* module;
+			};
+
+			struct cursor : sqlite3_vtab_cursor {
+				iterator i, e;
+				sqlite3_int64 rowid;
+			};
+
+			container_module(const container_type& c, std::vector<column_type> columns):
+				container_(c),
+				columns_(std::move(columns)),
+				key_(-1) {
+					std::stringstream s;
+					s << "create table x(";
+					for(size_t i = 0; i != columns_.size(); ++i) {
+						if (i) s << ",";
+						s << "\"" << columns_[i].name << "\" " << columns_[i].type;
+						if (columns_[i].key && key_ < 0) key_ = static_cast<int>(i);
+					}
+					s << ")";
+					schema_ = s.str();
+				}
+
+			static const sqlite3_module* sqlite_module() {
+				static sqlite3_module m = make_module();
+				return &m;
+			}
+
+		private:
+			const container_type& container_;
+			std::vector<column_type> columns_;
+			int key_;
+			std::string schema_;
+
+			static sqlite3_module make_module() {
+				sqlite3_module m;
+				memset(&m, 0, sizeof(m));
+				m.iVersion = 1;
+				m.xCreate = nullptr; // eponymous only: usable as "select ... from name"
+				m.xConnect = connect;
+				m.xBestIndex = best_index;
+				m.xDisconnect = disconnect;
+				m.xDestroy = disconnect;
+				m.xOpen = open;
+				m.xClose = close;
+				m.xFilter = filter;
+				m.xNext = next;
+				m.xEof = eof;
+				m.xColumn = column;
+				m.xRowid = rowid;
+				return m;
+			}
+
+			static container_module& self(sqlite3_vtab* vtab) {return *static_cast<table*>(vtab)->module;}
+
+			static int connect(sqlite3* db, void* aux, int, const char* const*, sqlite3_vtab** vtab, char**) {
+				auto module = static_cast<container_module*>(aux);
+				int ret = sqlite3_declare_vtab(db, module->schema_.c_str());
+				if (ret != SQLITE_OK) return ret;
+				auto t = new table();
+				t->module = module;
+				*vtab = t;
+				return SQLITE_OK;
+			}
+
+			static int disconnect(sqlite3_vtab* vtab) {
+				delete static_cast<table*>(vtab);
+				return SQLITE_OK;
+			}
+
+			static int best_index(sqlite3_vtab* vtab, sqlite3_index_info* info) {
+				auto& m = self(vtab);
+				double n = std::max<double>(std::distance(m.container_.begin(), m.container_.end()), 1);
+				int eq = -1, lower = -1, upper = -1, plan = 0;
+
+				for(int i = 0; i != info->nConstraint; ++i) {
+					auto& c = info->aConstraint[i];
+					if (!c.usable || m.key_ < 0 || c.iColumn != m.key_) continue;
+					if (m.columns_[m.key_].storage == SQLITE_TEXT && sqlite3_stricmp(sqlite3_vtab_collation(info, i), "BINARY")) continue;
+					switch(c.op) {
+						case SQLITE_INDEX_CONSTRAINT_EQ: eq = i; break;
+						case SQLITE_INDEX_CONSTRAINT_GT: lower = i; plan |= plan_lower_strict; break;
+						case SQLITE_INDEX_CONSTRAINT_GE: lower = i; plan &= ~plan_lower_strict; break;
+						case SQLITE_INDEX_CONSTRAINT_LT: upper = i; plan |= plan_upper_strict; break;
+						case SQLITE_INDEX_CONSTRAINT_LE: upper = i; plan &= ~plan_upper_strict; break;
+					}
+				}
+
+				int arg = 0;
+				if (eq >= 0) {
+					plan = plan_eq;
+					info->aConstraintUsage[eq].argvIndex = ++arg;
+					info->estimatedCost = std::log2(n) + 1;
+					info->estimatedRows = 1;
+				} else {
+					if (lower >= 0) {
+						plan |= plan_lower;
+						info->aConstraintUsage[lower].argvIndex = ++arg;
+					}
+					if (upper >= 0) {
+						plan |= plan_upper;
+						info->aConstraintUsage[upper].argvIndex = ++arg;
+					}
+					double rows = arg == 2 ? n / 16 : arg == 1 ? n / 4 : n;
+					info->estimatedCost = (arg ? std::log2(n) : 0) + rows;
+					info->estimatedRows = static_cast<sqlite3_int64>(rows);
+				}
+				info->idxNum = plan;
+
+				// iteration is in key order
+				if (info->nOrderBy == 1 && m.key_ >= 0 &&
+						info->aOrderBy[0].iColumn == m.key_ && !info->aOrderBy[0].desc) {
+					info->orderByConsumed = 1;
+				}
+				return SQLITE_OK;
+			}
+
+			static int open(sqlite3_vtab*, sqlite3_vtab_cursor** cur) {
+				*cur = new cursor();
+				return SQLITE_OK;
+			}
+
+			static int close(sqlite3_vtab_cursor* cur) {
+				delete static_cast<cursor*>(cur);
+				return SQLITE_OK;
+			}
+
+			static int filter(sqlite3_vtab_cursor* base, int plan, const char*, int argc, sqlite3_value** argv) {
+				auto& c = *static_cast<cursor*>(base);
+				auto& m = self(base->pVtab);
+				auto begin = m.container_.begin();
+				c.i = begin;
+				c.e = m.container_.end();
+
+				if (!plan) {
+					c.rowid = 0;
+					return SQLITE_OK;
+				}
+
+				try {
+					for(int a = 0; a != argc; ++a) {
+						if (sqlite3_value_type(argv[a]) == SQLITE_NULL) {
+							// comparisons with NULL match nothing
+							c.i = c.e;
+							return SQLITE_OK;
+						}
+					}
+
+					auto& key = m.columns_[m.key_];
+					auto& cmp = key.compare;
+					auto less = [&cmp](const row_type& r, sqlite3_value* v) {return cmp(r, v) < 0;};
+					auto greater = [&cmp](sqlite3_value* v, const row_type& r) {return cmp(r, v) > 0;};
+
+					// a value converted to the key type may compare differently, leave that bound to sqlite
+					auto exact = [&key](sqlite3_value* v) {
+						auto t = sqlite3_value_type(v);
+						return t == key.storage || (t == SQLITE_INTEGER && key.storage == SQLITE_FLOAT);
+					};
+
+					int arg = 0;
+					if (plan & plan_eq) {
+						if (exact(argv[arg])) {
+							c.i = std::lower_bound(c.i, c.e, argv[arg], less);
+							c.e = std::upper_bound(c.i, c.e, argv[arg], greater);
+						}
+					} else {
+						if (plan & plan_lower) {
+							auto v = argv[arg++];
+							if (exact(v)) {
+								c.i = plan & plan_lower_strict ?
+									std::upper_bound(c.i, c.e, v, greater) :
+									std::lower_bound(c.i, c.e, v, less);
+							}
+						}
+						if (plan & plan_upper) {
+							auto v = argv[arg++];
+							if (exact(v)) {
+								c.e = plan & plan_upper_strict ?
+									std::lower_bound(c.i, c.e, v, less) :
+									std::upper_bound(c.i, c.e, v, greater);
+							}
+						}
+					}
+				} catch (std::exception& e) {
+					base->pVtab->zErrMsg = sqlite3_mprintf("%s", e.what());
+					return SQLITE_ERROR;
+				}
+
+				c.rowid = std::distance(begin, c.i);
+				return SQLITE_OK;
+			}
+
+			static int next(sqlite3_vtab_cursor* base) {
+				auto& c = *static_cast<cursor*>(base);
+				++c.i;
+				++c.rowid;
+				return SQLITE_OK;
+			}
+
+			static int eof(sqlite3_vtab_cursor* base) {
+				auto& c = *static_cast<cursor*>(base);
+				return c.i == c.e;
+			}
+
+			static int column(sqlite3_vtab_cursor* base, sqlite3_context* ctx, int n) {
+				auto& c = *static_cast<cursor*>(base);
+				self(base->pVtab).columns_[n].result(ctx, *c.i);
+				return SQLITE_OK;
+			}
+
+			static int rowid(sqlite3_vtab_cursor* base, sqlite3_int64* id) {
+				*id = static_cast<cursor*>(base)->rowid;
+				return SQLITE_OK;
+			}
+	};
+
+}}}
+
+#endif
+
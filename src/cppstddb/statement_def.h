@@ -0,0 +1,228 @@
+#ifndef CPPSTDDB_STATEMENT_DEF_H
+#define CPPSTDDB_STATEMENT_DEF_H
+
+#include <cppstddb/front.h>
+#include <cstddef>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*
+   Statements declared at compile time: the sql with its parameter and
+   result column types,
+
+     struct score_by_name : statement_def<params<std::string>, results<std::string,int>> {
+         static constexpr const char* sql = "select name,score from score where name = ?";
+     };
+
+     auto s = prepare<score_by_name>(con);
+     for(auto [name, score] : s.query("Knuth")) ...
+
+   The placeholder count is checked against the parameters, and the driver's
+   parameter encoders and field decoders are picked per position when the
+   statement is instantiated, so binding and reading rows does no type
+   dispatch.  A std::optional parameter or result type maps to NULL.
+ */
+
+namespace cppstddb {
+
+    template<class... T> struct params {};
+    template<class... T> struct results {};
+
+    template<class Params, class Results> struct statement_def;
+
+    template<class... P, class... R> struct statement_def<params<P...>, results<R...>> {
+        using params_type = params<P...>;
+        using results_type = results<R...>;
+        using row_type = std::tuple<R...>;
+        static const int param_count = sizeof...(P);
+        static const int result_count = sizeof...(R);
+    };
+
+    /*
+       placeholders in sql: ? and ?NNN (sqlite, mysql) or $NNN (postgres),
+       not counting those in quotes or comments
+     */
+
+    constexpr int placeholder_count(const char* sql) {
+        int count = 0;
+        for(const char* p = sql; *p; ++p) {
+            char c = *p;
+            if (c == '\'' || c == '"' || c == '`') {
+                while (p[1] && p[1] != c) ++p;
+                if (!p[1]) break;
+                ++p;
+            } else if (c == '-' && p[1] == '-') {
+                while (p[1] && p[1] != '\n') ++p;
+            } else if (c == '/' && p[1] == '*') {
+                for(p += 2; *p && !(p[0] == '*' && p[1] == '/'); ++p) {}
+                if (!*p) break;
+                ++p;
+            } else if (c == '?' || c == '$') {
+                int n = 0;
+                bool numbered = false;
+                for(; p[1] >= '0' && p[1] <= '9'; ++p, numbered = true) n = n * 10 + (p[1] - '0');
+                if (numbered) count = n > count ? n : count;
+                else if (c == '?') ++count;
+            }
+        }
+        return count;
+    }
+}
+
+namespace cppstddb { namespace front {
+
+    template<class T> struct is_optional : std::false_type {};
+    template<class T> struct is_optional<std::optional<T>> : std::true_type {};
+
+    template<class T> struct value_of {using type = T;};
+    template<class T> struct value_of<std::optional<T>> {using type = T;};
+
+    // whether driver D binds parameters of type T
+    template<class D, class T, class = void> struct has_param_type : std::false_type {};
+    template<class D, class T> struct has_param_type<D, T,
+        decltype(void(&D::template param_type<T>::bind))> : std::true_type {};
+
+    template<class D, class T> void bind_param(typename D::statement& s, int idx, const T& v) {
+        if constexpr (is_optional<T>::value) {
+            if (v) bind_param<D>(s, idx, *v);
+            else D::template param_type<std::nullptr_t>::bind(s, idx, nullptr);
+        } else {
+            D::template param_type<T>::bind(s, idx, v);
+        }
+    }
+
+    // bind args to the placeholders of s in order, for its next execution
+    template<class D, class... A> void bind_params(typename D::statement& s, const A&... args) {
+        s.begin_bind();
+        int idx = 0;
+        (bind_param<D>(s, idx++, args), ...);
+    }
+
+    // column idx of the current row as T, std::nullopt for null when T is a std::optional
+    template<class D, class T> T get_field(rowset<D>& rows, size_t idx) {
+        auto& r = *rows.data_;
+        if constexpr (is_optional<T>::value) {
+            if (r.is_null(idx)) return std::nullopt;
+            return get_field<D, typename T::value_type>(rows, idx);
+        } else {
+            return D::template field_type<T>::as(r, cell<D>(r.binds[idx], idx, rows.row_idx_));
+        }
+    }
+
+    template<class D, class Results> class typed_rowset;
+
+    template<class D, class... R> class typed_rowset<D, results<R...>> {
+        public:
+            using database_type = D;
+            using rowset_t = rowset<database_type>;
+            using row_type = std::tuple<R...>;
+
+            class iterator {
+                public:
+                    typedef std::ptrdiff_t difference_type;
+                    typedef row_type value_type;
+                    typedef row_type reference;
+                    typedef void pointer;
+                    typedef std::input_iterator_tag iterator_category;
+                    typedef std::input_iterator_tag iterator_concept;
+
+                    iterator():rows_(nullptr) {}
+                    iterator(typed_rowset* r):rows_(r) {}
+                    row_type operator*() const {return rows_->front();}
+                    iterator& operator++() {
+                        rows_->pop_front();
+                        return *this;
+                    }
+                    void operator++(int) {rows_->pop_front();}
+                    bool at_end() const {return !rows_ || rows_->empty();}
+                    bool operator==(const iterator& rhs) const {return at_end() == rhs.at_end();}
+                    bool operator!=(const iterator& rhs) const {return !operator==(rhs);}
+
+                private:
+                    typed_rowset* rows_;
+            };
+
+            typed_rowset(statement<database_type>& stmt):rows_(stmt.rows()) {
+                if (rows_.width() != sizeof...(R)) raise_error("typed_statement: result columns", rows_.width());
+            }
+
+            bool empty() const {return rows_.empty();}
+            row_type front() {return decode(std::index_sequence_for<R...>());}
+            void pop_front() {rows_.next();}
+
+            iterator begin() {return iterator(this);}
+            iterator end() {return iterator(nullptr);}
+
+        private:
+            rowset_t rows_;
+
+            template<size_t... I> row_type decode(std::index_sequence<I...>) {
+                return row_type(get_field<database_type, R>(rows_, I)...);
+            }
+    };
+
+    template<class D, class Def, class Params = typename Def::params_type, class Results = typename Def::results_type>
+        class typed_statement;
+
+    template<class D, class Def, class... P, class... R>
+        class typed_statement<D, Def, params<P...>, results<R...>> {
+            static_assert(placeholder_count(Def::sql) == sizeof...(P),
+                    "sql placeholders do not match the statement parameters");
+            static_assert((has_param_type<D, typename value_of<P>::type>::value && ...),
+                    "parameter type not supported by the driver");
+            static_assert((has_field_type<D, typename value_of<R>::type>::value && ...),
+                    "result type not supported by the driver");
+
+            public:
+                using database_type = D;
+                using connection_t = connection<database_type>;
+                using statement_t = front::statement<database_type>;
+                using statement_type = typename database_type::statement;
+                using rowset_t = typed_rowset<database_type, results<R...>>;
+                using row_type = std::tuple<R...>;
+
+                typed_statement(connection_t con):statement_(con.statement(Def::sql)) {}
+
+                typed_statement& timeout(std::chrono::milliseconds t) {
+                    statement_.timeout(t);
+                    return *this;
+                }
+
+                // bind and run, parameters are only referenced for the call
+                typed_statement& execute(const P&... args) {
+                    bind_params<database_type>(*statement_.data_, args...);
+                    statement_.query();
+                    if constexpr (sizeof...(R) == 0) statement_.reset(); // no rows to read
+                    return *this;
+                }
+
+                rowset_t query(const P&... args) {
+                    execute(args...);
+                    return rowset_t(statement_);
+                }
+
+                statement_t& statement() {return statement_;}
+
+            private:
+                statement_t statement_;
+        };
+
+}}
+
+#ifdef CPPSTDDB_HAS_RANGES
+namespace std::ranges {
+    template<class D, class R> inline constexpr bool enable_view<cppstddb::front::typed_rowset<D,R>> = true;
+}
+#endif
+
+namespace cppstddb {
+
+    template<class Def, class D> auto prepare(front::connection<D> con) {
+        return front::typed_statement<D, Def>(con);
+    }
+
+}
+
+#endif
@@ -0,0 +1,325 @@
+#ifndef CPPSTDDB_TABLE_CACHE_H
+#define CPPSTDDB_TABLE_CACHE_H
+
+#include <cppstddb/front.h>
+#include <cppstddb/statement_def.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/*
+   A table kept in memory for lookups by key, for dimension rows read in
+   tight loops.  The table is loaded once into an open addressing hash map,
+   then refresh() (or a poll thread) reads only the rows whose watermark
+   column, an integer raised on every insert and update (a version,
+   sequence or epoch), is above the highest seen, and merges them.
+
+     table_cache_options o;
+     o.table = "users";
+     o.key = "id";
+     o.watermark = "version";
+     o.columns = "name,score";
+     auto users = cache_table<int, std::tuple<std::string,int>>(db, o);
+     users->visit(42, [](auto& row) {...});
+
+   Reads take no lock: a refresh builds a new map and publishes it with a
+   pointer swap, the old map is freed once the readers that may see it are
+   done (RCU: readers mark a per thread slot, the writer waits for the old
+   generation's slots to empty).  Rows are shared between map versions, a
+   refresh copies the slots, not the rows.
+
+   Deletes are not seen: mark rows deleted (and raise the watermark) instead.
+   A row that commits with a watermark below one already read is missed,
+   overlap re-reads that far below the highest seen.
+ */
+
+namespace cppstddb {
+
+    struct table_cache_options {
+        std::string table;                      // or a view
+        std::string key;                        // unique key column
+        std::string watermark;                  // integer column raised on insert and update
+        std::string columns;                    // the row, in Row order
+        long long overlap = 0;                  // re-read rows this far below the highest watermark
+        std::chrono::milliseconds poll_interval{0}; // refresh from a thread (0: refresh() only)
+    };
+
+}
+
+namespace cppstddb { namespace front {
+
+    template<class D, class Key, class Row, class W = long long> class table_cache;
+
+    template<class D, class Key, class... R, class W> class table_cache<D, Key, std::tuple<R...>, W> {
+        static_assert((has_field_type<D, typename value_of<R>::type>::value && ...),
+                "row type not supported by the driver");
+        static_assert(has_field_type<D, Key>::value, "key type not supported by the driver");
+        static_assert(has_field_type<D, W>::value, "watermark type not supported by the driver");
+
+        public:
+            using database_type = D;
+            using database_t = basic_database<database_type>;
+            using connection_t = connection<database_type>;
+            using rowset_t = rowset<database_type>;
+            using key_type = Key;
+            using row_type = std::tuple<R...>;
+
+            table_cache(database_t db, const table_cache_options& o):
+                con_(db.connection()),
+                options_(o),
+                current_(new table()),
+                epoch_(0),
+                watermark_(),
+                loaded_(false),
+                stop_(false) {
+                    select_ = "select " + o.key + "," + o.watermark + (sizeof...(R) ? "," + o.columns : "") + " from " + o.table;
+                    try {
+                        refresh();
+                    } catch (...) {
+                        delete current_.load();
+                        throw;
+                    }
+                    if (o.poll_interval.count()) thread_ = std::thread([this] {poll();});
+                }
+
+            // no reads may be running
+            ~table_cache() {
+                if (thread_.joinable()) {
+                    {
+                        std::lock_guard<std::mutex> lock(poll_mutex_);
+                        stop_ = true;
+                    }
+                    poll_cv_.notify_all();
+                    thread_.join();
+                }
+                delete current_.load();
+            }
+
+            table_cache(const table_cache&) = delete;
+            table_cache& operator=(const table_cache&) = delete;
+
+            // f(const row_type&) for the key's row, false when there is none; safe from any thread
+            template<class F> bool visit(const key_type& key, F f) const {
+                read_section section(*this);
+                auto row = current_.load()->find(key);
+                if (!row) return false;
+                f(*row);
+                return true;
+            }
+
+            std::optional<row_type> find(const key_type& key) const {
+                std::optional<row_type> r;
+                visit(key, [&r](const row_type& row) {r = row;});
+                return r;
+            }
+
+            bool contains(const key_type& key) const {return visit(key, [](const row_type&) {});}
+
+            size_t size() const {
+                read_section section(*this);
+                return current_.load()->size;
+            }
+
+            // the highest watermark read
+            W watermark() const {
+                std::lock_guard<std::mutex> lock(refresh_mutex_);
+                return watermark_;
+            }
+
+            // read and merge rows changed since the last refresh, the number read
+            size_t refresh() {
+                std::lock_guard<std::mutex> lock(refresh_mutex_);
+                auto sql = select_;
+                if (loaded_) sql += " where " + options_.watermark + " > " + std::to_string(watermark_ - options_.overlap);
+
+                // the sql changes with the watermark: run it direct
+                auto stmt = con_.statement(sql, execution::direct);
+                auto rows = stmt.query().rows();
+                std::vector<std::pair<key_type, row_ptr>> changed;
+                W high = watermark_;
+                bool first = !loaded_;
+                for(; !rows.empty(); rows.next()) {
+                    auto w = get_field<database_type, W>(rows, 1);
+                    if (first || w > high) {
+                        high = w;
+                        first = false;
+                    }
+                    changed.emplace_back(
+                            get_field<database_type, key_type>(rows, 0),
+                            std::make_shared<const row_type>(read_row(rows, std::index_sequence_for<R...>())));
+                }
+
+                if (!changed.empty()) publish(merge(*current_.load(), changed));
+                watermark_ = high;
+                loaded_ = true;
+                return changed.size();
+            }
+
+        private:
+            using row_ptr = std::shared_ptr<const row_type>;
+
+            struct slot {
+                key_type key;
+                row_ptr row; // null: empty
+            };
+
+            // linear probing, at most half full
+            struct table {
+                std::vector<slot> slots;
+                size_t size = 0;
+
+                explicit table(size_t capacity = 16):slots(capacity) {}
+
+                size_t home(const key_type& key) const {
+                    // fibonacci hashing spreads the low bits std::hash leaves alone
+                    uint64_t h = std::hash<key_type>()(key) * 0x9e3779b97f4a7c15ull;
+                    return static_cast<size_t>(h >> 32) & (slots.size() - 1);
+                }
+
+                const row_type* find(const key_type& key) const {
+                    auto mask = slots.size() - 1;
+                    for(auto i = home(key);; i = (i + 1) & mask) {
+                        auto& s = slots[i];
+                        if (!s.row) return nullptr;
+                        if (s.key == key) return s.row.get();
+                    }
+                }
+
+                void insert(const key_type& key, row_ptr row) {
+                    auto mask = slots.size() - 1;
+                    for(auto i = home(key);; i = (i + 1) & mask) {
+                        auto& s = slots[i];
+                        if (!s.row) {
+                            s.key = key;
+                            s.row = std::move(row);
+                            ++size;
+                            return;
+                        }
+                        if (s.key == key) {
+                            s.row = std::move(row);
+                            return;
+                        }
+                    }
+                }
+            };
+
+            // reader counts by generation, a cache line per slot
+            struct alignas(64) reader_slot {
+                std::atomic<long> count[2] = {{0}, {0}};
+            };
+
+            static const size_t reader_slots = 64;
+
+            // marks the calling thread as reading the current generation
+            class read_section {
+                public:
+                    read_section(const table_cache& c):slot_(c.readers_[thread_index() % reader_slots]) {
+                        for(;;) {
+                            generation_ = c.epoch_.load() & 1;
+                            ++slot_.count[generation_];
+                            if ((c.epoch_.load() & 1) == generation_) break;
+                            --slot_.count[generation_]; // the writer moved on, retry in the new generation
+                        }
+                    }
+                    ~read_section() {--slot_.count[generation_];}
+
+                    read_section(const read_section&) = delete;
+                    read_section& operator=(const read_section&) = delete;
+
+                private:
+                    reader_slot& slot_;
+                    size_t generation_;
+
+                    static size_t thread_index() {
+                        static std::atomic<size_t> next(0);
+                        static thread_local size_t index = next++;
+                        return index;
+                    }
+            };
+
+            connection_t con_; // refresh only
+            table_cache_options options_;
+            std::string select_;
+
+            std::atomic<const table*> current_;
+            std::atomic<uint64_t> epoch_;
+            mutable reader_slot readers_[reader_slots];
+
+            mutable std::mutex refresh_mutex_;
+            W watermark_;
+            bool loaded_;
+
+            bool stop_;
+            std::mutex poll_mutex_;
+            std::condition_variable poll_cv_;
+            std::thread thread_;
+
+            template<size_t... I> static row_type read_row(rowset_t& rows, std::index_sequence<I...>) {
+                return row_type(get_field<database_type, R>(rows, I + 2)...);
+            }
+
+            static table* merge(const table& old, std::vector<std::pair<key_type, row_ptr>>& changed) {
+                size_t capacity = old.slots.size();
+                while (capacity < 2 * (old.size + changed.size())) capacity *= 2;
+                table* t;
+                if (capacity == old.slots.size()) {
+                    t = new table(old);
+                } else {
+                    t = new table(capacity);
+                    for(auto& s : old.slots) {
+                        if (s.row) t->insert(s.key, s.row);
+                    }
+                }
+                for(auto& c : changed) t->insert(c.first, std::move(c.second));
+                return t;
+            }
+
+            // under the refresh lock
+            void publish(const table* t) {
+                auto old = current_.exchange(t);
+                // readers that marked the old generation may still see the old table
+                auto generation = epoch_++ & 1;
+                for(auto& r : readers_) {
+                    while (r.count[generation].load()) std::this_thread::yield();
+                }
+                delete old;
+            }
+
+            void poll() {
+                std::unique_lock<std::mutex> lock(poll_mutex_);
+                while (!poll_cv_.wait_for(lock, options_.poll_interval, [this] {return stop_;})) {
+                    lock.unlock();
+                    try {
+                        refresh();
+                    } catch (std::exception& e) {
+                        DB_WARN("table_cache: refresh failed: " << e.what());
+                    }
+                    lock.lock();
+                }
+            }
+    };
+
+}}
+
+namespace cppstddb {
+
+    // a table_cache for db, loaded before it is returned
+    template<class Key, class Row, class W = long long, class D>
+        auto cache_table(front::basic_database<D> db, const table_cache_options& o) {
+            return std::make_unique<front::table_cache<D, Key, Row, W>>(db, o);
+        }
+
+}
+
+#endif
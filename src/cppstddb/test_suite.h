@@ -2,6 +2,17 @@
 #define CPPSTDDB_TEST_SUITE_H
 
 #include <cppstddb/sql_util.h>
+#include <cppstddb/writer.h>
+#include <cppstddb/statement_def.h>
+#include <cppstddb/value.h>
+#include <cppstddb/prefetch.h>
+#include <cppstddb/parallel.h>
+#include <cppstddb/write_queue.h>
+#include <cppstddb/table_cache.h>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <chrono>
 #include <ostream>
 #include <stdexcept>
 #include <numeric>
@@ -148,6 +159,423 @@ namespace cppstddb {
         assertion(sum == 194);
     }
 
+    inline std::string read_file(FILE* f) {
+        std::string s;
+        char buf[4096];
+        rewind(f);
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) != 0) s.append(buf, n);
+        return s;
+    }
+
+    template<class database> void csv_writer_test(const std::string& uri) {
+        test_header("csv_writer_test");
+
+        auto db = database(uri);
+        auto r = db.statement("select name,score,d from score").query().rows();
+
+        FILE* f = tmpfile();
+        write_csv(r, fileno(f));
+        auto s = read_file(f);
+        fclose(f);
+
+        std::cout << s;
+        assertion(s ==
+                "name,score,d\r\n"
+                "Knuth,62,2016-01-01\r\n"
+                "Hopper,48,2016-02-02\r\n"
+                "Dijkstra,84,2016-03-03\r\n");
+        assertion(r.empty());
+    }
+
+    template<class database> void json_lines_writer_test(const std::string& uri) {
+        test_header("json_lines_writer_test");
+
+        auto db = database(uri);
+        auto r = db.statement("select name,score,d from score").query().rows();
+
+        FILE* f = tmpfile();
+        write_json_lines(r, fileno(f));
+        auto s = read_file(f);
+        fclose(f);
+
+        std::cout << s;
+        std::string prefix = "{\"name\":\"Knuth\",";
+        assertion(s.compare(0, prefix.size(), prefix) == 0);
+        assertion(std::count(s.begin(), s.end(), '\n') == 3);
+    }
+
+    template<class database> void timeout_test(const std::string& uri, const std::string& slow_sql) {
+        test_header("timeout_test");
+        using namespace std::chrono;
+
+        auto db = database(uri);
+        auto start = steady_clock::now();
+        bool timed_out = false;
+        try {
+            auto stmt = db.connection().statement(slow_sql);
+            stmt.timeout(milliseconds(100));
+            auto r = stmt.query().rows();
+            for(auto row : r) {}
+        } catch (timeout_error& e) {
+            std::cout << "timeout: " << e.what() << "\n";
+            timed_out = true;
+        }
+        assertion(timed_out, "expected timeout_error");
+        assertion(steady_clock::now() - start < seconds(5), "timeout took too long");
+    }
+
+    template<class database> void snapshot_test(const std::string& uri) {
+        test_header("snapshot_test");
+        std::string long_name(100, 'x');
+        value a(long_name), b = a, c(42), d;
+        assertion(a.is_external() && b == a && b.view().data() != a.view().data());
+        assertion(!value("short").is_external() && value("short").view() == "short");
+        assertion(c.type() == value_int && c.as<long>() == 42 && d.is_null() && c != d);
+        auto e = value::borrow(long_name), f = e;
+        assertion(e.view().data() == long_name.data() && f.view().data() != long_name.data());
+
+        // rows kept past next()
+        auto db = database(uri);
+        std::vector<row_snapshot> rows;
+        for(auto row : db.statement("select name,score from score").query().rows()) rows.emplace_back(row);
+        for(auto& r : rows) std::cout << r << "\n";
+        assertion(rows.size() == 3 && rows[0].size() == 2);
+        assertion(rows[0][0].as<std::string>() == "Knuth" && rows[0][1].as<int>() == 62);
+        assertion(rows[2][0].as<std::string>() == "Dijkstra");
+        auto copy = rows[2];
+        assertion(copy[0] == rows[2][0] && copy[1] == rows[2][1]);
+    }
+
+    template<class database> void prefetch_test(const std::string& uri) {
+        test_header("prefetch_test");
+        auto db = database(uri);
+        for(size_t block_rows : {1, 2, 3, 100}) {
+            std::vector<std::string> names;
+            for(auto& row : prefetch(db.statement("select name,score from score").query().rows(), block_rows)) {
+                names.push_back(row[0].template as<std::string>());
+            }
+            assertion(names.size() == 3 && names[0] == "Knuth" && names[2] == "Dijkstra");
+        }
+
+        // abandoned part way
+        auto p = prefetch(db.statement("select name from score").query().rows(), 1);
+        assertion(!p.empty() && p.front()[0].template as<std::string>() == "Knuth");
+    }
+
+    template<class database> void parallel_test(const std::string& uri) {
+        test_header("parallel_test");
+        auto db = database(uri);
+        std::atomic<int> count(0);
+        parallel_for_each(db.statement("select name,score from score").query().rows(),
+                [&count](const row_snapshot&) {++count;}, 4, 1);
+        assertion(count == 3);
+
+        auto sum = parallel_reduce(db.statement("select name,score from score").query().rows(), 0,
+                [](int& acc, const row_snapshot& row) {acc += row[1].as<int>();},
+                [](int& acc, const int& other) {acc += other;}, 4, 1);
+        assertion(sum == 194);
+
+        // ordered completion
+        std::vector<std::string> names;
+        parallel_transform(db.statement("select name,score from score").query().rows(),
+                [](const row_snapshot& row) {return row[0].as<std::string>();},
+                [&names](std::string name) {names.push_back(std::move(name));}, 3, 1);
+        assertion(names.size() == 3 && names[0] == "Knuth" && names[1] == "Hopper" && names[2] == "Dijkstra");
+
+        bool thrown = false;
+        try {
+            parallel_for_each(db.statement("select name,score from score").query().rows(),
+                    [](const row_snapshot&) {throw std::runtime_error("worker");}, 2, 1);
+        } catch (std::runtime_error& e) {
+            thrown = true;
+        }
+        assertion(thrown);
+    }
+
+    template<class database> void try_query_test(const std::string& uri) {
+        test_header("try_query_test");
+        auto db = database(uri);
+        drop_table(db, "try_test");
+        db.query("create table try_test (id integer primary key)");
+        auto con = db.connection();
+        assertion(con.statement("insert into try_test values(1)").try_query().has_value());
+
+        auto r = con.statement("insert into try_test values(1)").try_query();
+        assertion(!r && r.error().kind() == error_kind::unique_violation);
+        std::cout << r.error() << "\n";
+
+        bool thrown = false;
+        try {
+            r.value();
+        } catch (database_error& e) {
+            thrown = true;
+        }
+        assertion(thrown);
+
+        // the statement and connection are gone, the error keeps them for its message
+        auto gone = db.connection().statement("insert into try_test values(1)").try_query();
+        assertion(!gone && *gone.error().detail());
+
+        int n = 0;
+        auto rows = con.statement("select name from score").query().rows();
+        for(; !rows.empty(); ++n) {
+            auto next = rows.try_next();
+            assertion(next.has_value());
+        }
+        assertion(n == 3);
+        drop_table(db, "try_test");
+    }
+
+    template<class database> void execution_test(const std::string& uri) {
+        test_header("execution_test");
+        auto db = database(uri);
+        const char* sql = "select name,score,d from score order by name";
+        auto prepared = db.statement(sql).query().rows();
+        auto direct = db.statement(sql, execution::direct).query().rows();
+        int n = 0;
+        for(; !prepared.empty(); ++n, prepared.next(), direct.next()) {
+            assertion(!direct.empty());
+            auto a = prepared.front(), b = direct.front();
+            assertion(a[0].str() == b[0].str() && a[1].template as<int>() == b[1].template as<int>());
+            auto da = a[2].template as<date_t>(), dd = b[2].template as<date_t>();
+            assertion(da.year() == dd.year() && da.month() == dd.month() && da.day() == dd.day());
+        }
+        assertion(n == 3 && direct.empty());
+
+        // executed again, the sql is sent again
+        auto stmt = db.statement("select count(*) from score", execution::direct);
+        for(int i = 0; i != 3; ++i) assertion(stmt.query().rows().front()[0].template as<int>() == 3);
+    }
+
+    template<class database> void table_cache_test(const std::string& uri) {
+        test_header("table_cache_test");
+        auto db = database(uri);
+        auto con = db.connection();
+        drop_table(db, "cache_test");
+        con.query("create table cache_test (id integer, name varchar(10), score integer, version integer)");
+        con.query("insert into cache_test values (1,'Knuth',62,1), (2,'Hopper',48,2)");
+
+        table_cache_options o;
+        o.table = "cache_test";
+        o.key = "id";
+        o.watermark = "version";
+        o.columns = "name,score";
+        auto cache = cache_table<int, std::tuple<std::string,int>, int>(db, o);
+        assertion(cache->size() == 2 && cache->watermark() == 2);
+        assertion(std::get<0>(*cache->find(1)) == "Knuth" && !cache->contains(3));
+
+        // lookups run while rows change and the map grows
+        std::atomic<bool> done(false);
+        std::atomic<int> bad(0);
+        std::thread reader([&] {
+                while (!done) {
+                    if (!cache->visit(1, [&bad](auto& row) {if (std::get<1>(row) < 62) ++bad;})) ++bad;
+                }
+                });
+        con.query("update cache_test set score = 90, version = 3 where id = 1");
+        auto updated = cache->refresh();
+        for(int i = 3; i != 40; ++i) {
+            auto id = std::to_string(i);
+            con.query("insert into cache_test values (" + id + ",'n" + id + "'," + id + "," + std::to_string(i + 1) + ")");
+            cache->refresh();
+        }
+        done = true;
+        reader.join();
+
+        assertion(updated == 1 && !bad);
+        assertion(cache->size() == 39 && cache->watermark() == 40);
+        assertion(std::get<1>(*cache->find(1)) == 90 && std::get<0>(*cache->find(39)) == "n39");
+        assertion(cache->refresh() == 0);
+
+        o.poll_interval = std::chrono::milliseconds(5);
+        auto polled = cache_table<int, std::tuple<std::string,int>, int>(db, o);
+        con.query("insert into cache_test values (40,'Turing',90,41)");
+        for(int i = 0; i != 400 && !polled->contains(40); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        assertion(polled->contains(40));
+        polled.reset();
+        drop_table(db, "cache_test");
+    }
+
+    template<class database> void admission_test(const std::string& uri) {
+        test_header("admission_test");
+        using namespace std::chrono;
+        auto db = database(uri);
+        admission_control::options o;
+        o.limit = 1;
+        o.interactive_timeout = milliseconds(0);
+        o.batch_timeout = seconds(5);
+        auto a = std::make_shared<admission_control>(o);
+        db.admission(a);
+
+        // full: interactive is turned away at once
+        auto held = std::make_unique<admission_control::permit>(a->admit(priority_class::interactive));
+        auto con = db.connection();
+        auto r = con.statement("select name from score").try_query();
+        assertion(!r && r.error().kind() == error_kind::overloaded);
+        bool thrown = false;
+        try {
+            con.statement("select name from score").query();
+        } catch (overload_error& e) {
+            thrown = true;
+        }
+        assertion(thrown);
+
+        held.reset();
+
+        // interactive waiters go before batch ones (a controller that lets them wait)
+        auto waiting = o;
+        waiting.interactive_timeout = seconds(5);
+        auto ordered = std::make_shared<admission_control>(waiting);
+        held = std::make_unique<admission_control::permit>(ordered->admit(priority_class::interactive));
+        std::mutex mutex;
+        std::vector<priority_class> order;
+        int failed = 0;
+        auto wait = [&](priority_class p) {
+            auto permit = ordered->try_admit(p);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (permit) order.push_back(p);
+            else ++failed;
+        };
+        std::thread batch(wait, priority_class::batch);
+        while (ordered->stats().queued[1] != 1) std::this_thread::yield();
+        std::thread interactive(wait, priority_class::interactive);
+        while (ordered->stats().queued[0] != 1) std::this_thread::yield();
+        held.reset();
+        batch.join();
+        interactive.join();
+        assertion(failed == 0 && order.size() == 2 && order[0] == priority_class::interactive);
+
+        auto n = con.statement("select count(*) from score").query().rows().front()[0].template as<int>();
+        assertion(n == 3);
+        assertion(a->stats().in_flight == 0 && a->stats().rejected == 2);
+
+        // the permit is held until the rows are read
+        auto rows = con.statement("select name from score").query().rows();
+        assertion(a->stats().in_flight == 1);
+        for(; !rows.empty(); rows.next()) {}
+        assertion(a->stats().in_flight == 0);
+
+        // or until the rowset is dropped, or its statement reset
+        auto kept = con.statement("select name from score");
+        assertion(kept.query().rows().front()[0].str() == "Knuth"); // the rowset ends with the full expression
+        assertion(a->stats().in_flight == 0);
+        auto partial = kept.query().rows();
+        assertion(a->stats().in_flight == 1);
+        kept.reset();
+        assertion(a->stats().in_flight == 0);
+
+        // a latency target nothing meets brings the limit down
+        o.limit = 8;
+        o.target_latency = microseconds(1);
+        auto adaptive = std::make_shared<admission_control>(o);
+        db.admission(adaptive);
+        for(int i = 0; i != 20; ++i) {
+            con.statement("select name from score").query();
+            std::this_thread::sleep_for(microseconds(10));
+        }
+        assertion(adaptive->stats().limit < 8);
+        db.admission(nullptr);
+    }
+
+#ifdef CPPSTDDB_HAS_RANGES
+    template<class database> void ranges_test(const std::string& uri) {
+        test_header("ranges_test");
+        static_assert(std::ranges::input_range<typename database::rowset_t>);
+        static_assert(std::ranges::view<typename database::rowset_t>);
+
+        // lazy over live fetching, take stops reading after the first match
+        auto db = database(uri);
+        auto names = db.statement("select name,score from score").query().rows()
+            | std::views::filter([](auto row) {return row[1].template as<int>() > 50;})
+            | std::views::transform([](auto row) {return row[0].template as<std::string>();})
+            | std::views::take(1);
+        std::vector<std::string> v;
+        for(auto&& name : names) v.push_back(name);
+        assertion(v.size() == 1 && v[0] == "Knuth");
+
+        auto r = db.statement("select name from score").query().rows();
+        auto n = std::ranges::distance(r.begin(), std::default_sentinel);
+        assertion(n == 3);
+    }
+#endif
+
+    /*
+       Insert and Select are statement_defs in the driver's placeholder syntax:
+       params<std::string,std::optional<int>>, results<> for insert into score(name,score)
+       params<int>, results<std::string,std::optional<int>> for scores above ? ascending
+     */
+    template<class database, class Insert, class Select> void typed_statement_test(const std::string& uri) {
+        test_header("typed_statement_test");
+        static_assert(placeholder_count("select '?', \"a?\" from t where a = ? and b = ? -- ?") == 2);
+        static_assert(placeholder_count("select $1, $2 /* $3 */") == 2);
+        static_assert(placeholder_count("select ?2, ?") == 3);
+
+        auto db = database(uri);
+        recreate_score_table(db);
+        {
+            auto con = db.connection();
+
+            auto insert = prepare<Insert>(con);
+            insert.execute("Turing", 90);
+            insert.execute("Liskov", 77);
+            insert.execute("Hoare", std::nullopt);
+
+            auto select = prepare<Select>(con);
+            int n = 0, last = 0;
+            for(auto [name, score] : select.query(60)) {
+                std::cout << name << "," << *score << "\n";
+                assertion(*score > 60 && *score >= last);
+                last = *score;
+                ++n;
+            }
+            assertion(n == 4, "typed query row count");
+
+            // rebinding the same statement
+            assertion(select.query(100).empty());
+            auto r = select.query(85);
+            assertion(std::get<0>(r.front()) == "Turing");
+        }
+
+        recreate_score_table(db);
+    }
+
+    // Insert as for typed_statement_test
+    template<class database, class Insert> void write_queue_test(const std::string& uri) {
+        test_header("write_queue_test");
+        auto db = database(uri);
+        recreate_score_table(db, false);
+        front::write_queue_stats stats;
+        std::atomic<int> errors(0);
+        {
+            front::write_queue q(db, 64);
+            std::vector<std::thread> producers;
+            for(int t = 0; t != 4; ++t) {
+                producers.emplace_back([&q, &errors, t] {
+                        std::vector<std::future<void>> done;
+                        for(int i = 0; i != 250; ++i) {
+                            done.push_back(q.template push<Insert>("w" + std::to_string(t), i));
+                        }
+                        for(auto& f : done) {
+                            try {
+                                f.get();
+                            } catch (std::exception& e) {
+                                ++errors;
+                            }
+                        }
+                        });
+            }
+            for(auto& p : producers) p.join();
+            stats = q.stats();
+        }
+        std::cout << "writes: " << stats.writes << ", batches: " << stats.batches << "\n";
+        assertion(errors == 0 && stats.writes == 1000 && stats.failed == 0);
+        assertion(stats.batches < stats.writes, "writes grouped into batches");
+        auto n = db.statement("select count(*) from score").query().rows().front()[0].template as<int>();
+        assertion(n == 1000);
+        recreate_score_table(db);
+    }
+
     template<class database> void test_all(const std::string& uri) {
         {
             auto db = database(uri);
@@ -162,6 +590,18 @@ namespace cppstddb {
         iterator_1_test<database>(uri);
         stl_find_if_test<database>(uri);
         stl_accumulate_test<database>(uri);
+        csv_writer_test<database>(uri);
+        json_lines_writer_test<database>(uri);
+        snapshot_test<database>(uri);
+        prefetch_test<database>(uri);
+        parallel_test<database>(uri);
+        try_query_test<database>(uri);
+        admission_test<database>(uri);
+        execution_test<database>(uri);
+        table_cache_test<database>(uri);
+#ifdef CPPSTDDB_HAS_RANGES
+        ranges_test<database>(uri);
+#endif
     }
 
 
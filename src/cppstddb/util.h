@@ -2,6 +2,8 @@
 #define CPPSTDDB_UTIL_H
 
 #include "source.h"
+#include <algorithm>
+#include <sstream>
 
 namespace cppstddb {
 
@@ -40,11 +42,12 @@ namespace cppstddb {
                 sentinel e, 
                 string& key, 
                 string& value) {
+            // a key without '=' (flag) gets an empty value
             auto s = i;
-            while (i != e && *i != '=' ) ++i;
-            if (i == e) return;
+            while (i != e && *i != '=' && *i != '&') ++i;
             key.assign(s,i);
-            if (++i == e) return;
+            if (i == e) return;
+            if (*i++ == '&') return;
             s = i;
             while (i != e && *i != '&' ) ++i;
             value.assign(s,i);
@@ -56,11 +59,14 @@ namespace cppstddb {
             const std::string& value,
             source& src) {
 
-        // better logic soon
         if (key == "username") {
             src.username = value;
         } else if (key == "password") {
             src.password = value;
+        } else if (key == "port") {
+            src.port = static_cast<int>(source::parse_int(key, value));
+        } else if (!key.empty()) {
+            src.options[key] = value;
         }
     }
 
@@ -87,8 +93,14 @@ namespace cppstddb {
 
         auto iter = uri.begin(), end = uri.end();
         if (! get_token_and_key(iter, end, "://", s.protocol)) return s;
-        if (! get_token_and_key(iter, end, "/", s.server)) return s;
-        if (! get_token_and_key(iter, end, "?", s.database)) return s;
+
+        // server[/database][?query], a query value may itself contain '/'
+        auto query = std::find(iter, end, '?');
+        auto slash = std::find(iter, query, '/');
+        s.server.assign(iter, slash);
+        if (slash != query) s.database.assign(slash + 1, query);
+        iter = query;
+        if (iter != end) ++iter;
 
         while (iter != end) {
             std::string key,value;
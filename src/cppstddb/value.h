@@ -0,0 +1,368 @@
+#ifndef CPPSTDDB_VALUE_H
+#define CPPSTDDB_VALUE_H
+
+#include <cppstddb/front.h>
+#include <cppstddb/database_error.h>
+#include <cppstddb/date.h>
+#include <cppstddb/decimal.h>
+#include <experimental/string_view>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/*
+   value: one column value of any type in 32 bytes.  Numbers, dates and
+   times are stored in place, text and blobs up to inline_size bytes are
+   too, longer ones go to the heap.  Decimals keep the driver's text.
+
+   row_snapshot: an owning copy of a row that outlives next(), laid out in
+   a single allocation, the values followed by the bytes of any strings too
+   long to be inline.
+ */
+
+namespace cppstddb {
+
+    class value {
+        public:
+            using string_view = std::experimental::string_view;
+            static const size_t inline_size = 30;
+
+            value():type_(value_undef),info_(store_null) {}
+            value(std::nullptr_t):value() {}
+
+            template<class T, class = typename std::enable_if<std::is_integral<T>::value>::type>
+                value(T v) {
+                    store<int64_t>(v, std::is_same<T,int>::value ? value_int : value_int64);
+                }
+
+            value(double v) {store(v, value_double);}
+            value(date_t v) {store(v, value_date);}
+            value(datetime_t v) {store(v, value_datetime);}
+            value(std::chrono::microseconds v) {store<int64_t>(v.count(), value_time);}
+
+            // copies s: strings, blobs (value_blob) and decimal text (value_decimal)
+            value(string_view s, value_type type = value_string) {copy(s, type);}
+
+            // refers to s without copying, s must outlive the value and its moves
+            static value borrow(string_view s, value_type type = value_string) {
+                if (s.size() <= inline_size) return value(s, type);
+                value v;
+                v.set_external(s.data(), s.size(), type, store_borrowed);
+                return v;
+            }
+
+            // copies own their bytes, also copies of borrowed values
+            value(const value& other) {
+                if (other.is_external()) copy(other.view(), other.type());
+                else memcpy(static_cast<void*>(this), &other, sizeof(value));
+            }
+
+            value(value&& other) noexcept {
+                memcpy(static_cast<void*>(this), &other, sizeof(value));
+                other.info_ = store_null;
+            }
+
+            value& operator=(value other) noexcept {
+                std::swap_ranges(
+                        reinterpret_cast<char*>(this), reinterpret_cast<char*>(this) + sizeof(value),
+                        reinterpret_cast<char*>(&other));
+                return *this;
+            }
+
+            ~value() {
+                if (storage() == store_heap) delete[] external().p;
+            }
+
+            value_type type() const {return static_cast<value_type>(type_);}
+            bool is_null() const {return storage() == store_null;}
+
+            // bytes kept outside the value (heap or borrowed)
+            bool is_external() const {return storage() == store_heap || storage() == store_borrowed;}
+
+            // the same value, long strings borrowed from this one
+            value ref() const {return is_external() ? borrow(view(), type()) : *this;}
+
+            string_view view() const {
+                if (storage() == store_inline) return string_view(reinterpret_cast<const char*>(data_), info_ >> 3);
+                if (is_external()) return string_view(external().p, external().n);
+                mismatch("string");
+                return string_view();
+            }
+
+            int64_t as_int64() const {
+                switch(type_) {
+                    case value_int:
+                    case value_int64: return load<int64_t>();
+                    case value_double: return static_cast<int64_t>(load<double>());
+                    case value_decimal: {
+                                            auto s = view();
+                                            auto d = decimal_t::parse(s.data(), s.size());
+                                            auto v = d.value();
+                                            for(int i = 0; i != d.scale(); ++i) v /= 10;
+                                            return v;
+                                        }
+                }
+                mismatch("integer");
+                return 0;
+            }
+
+            double as_double() const {
+                switch(type_) {
+                    case value_double: return load<double>();
+                    case value_int:
+                    case value_int64: return static_cast<double>(load<int64_t>());
+                    case value_decimal: {
+                                            auto s = view();
+                                            return decimal_t::text_to_double(s.data(), s.size());
+                                        }
+                }
+                mismatch("double");
+                return 0;
+            }
+
+            template<class T> T as() const {
+                if (is_null()) throw database_error("value: null");
+                if constexpr (std::is_integral<T>::value) {
+                    return static_cast<T>(as_int64());
+                } else if constexpr (std::is_floating_point<T>::value) {
+                    return static_cast<T>(as_double());
+                } else if constexpr (std::is_same<T,date_t>::value) {
+                    if (type_ == value_datetime) return load<datetime_t>().date();
+                    return scalar<date_t>(value_date, "date");
+                } else if constexpr (std::is_same<T,datetime_t>::value) {
+                    return scalar<datetime_t>(value_datetime, "datetime");
+                } else if constexpr (std::is_same<T,std::chrono::microseconds>::value) {
+                    return std::chrono::microseconds(scalar<int64_t>(value_time, "time"));
+                } else if constexpr (std::is_same<T,decimal_t>::value) {
+                    if (type_ != value_decimal) return decimal_t(as_int64(), 0);
+                    auto s = view();
+                    return decimal_t::parse(s.data(), s.size());
+                } else if constexpr (std::is_same<T,string_view>::value) {
+                    return view();
+                } else {
+                    // strings and byte vectors
+                    auto s = view();
+                    return T(s.data(), s.data() + s.size());
+                }
+            }
+
+            friend bool operator==(const value& a, const value& b) {
+                if (a.type_ != b.type_ || a.is_null() != b.is_null()) return false;
+                if (a.is_null()) return true;
+                switch(a.type_) {
+                    case value_int:
+                    case value_int64:
+                    case value_time: return a.load<int64_t>() == b.load<int64_t>();
+                    case value_double: return a.load<double>() == b.load<double>();
+                    case value_date: return same_date(a.load<date_t>(), b.load<date_t>());
+                    case value_datetime: {
+                                             auto x = a.load<datetime_t>(), y = b.load<datetime_t>();
+                                             return same_date(x.date(), y.date()) &&
+                                                 x.hour() == y.hour() && x.minute() == y.minute() &&
+                                                 x.second() == y.second() && x.microsecond() == y.microsecond();
+                                         }
+                }
+                return a.view() == b.view();
+            }
+
+            friend bool operator!=(const value& a, const value& b) {return !(a == b);}
+
+            friend std::ostream& operator<<(std::ostream& os, const value& v) {
+                if (v.is_null()) return os << "null";
+                switch(v.type_) {
+                    case value_int:
+                    case value_int64: return os << v.load<int64_t>();
+                    case value_double: return os << v.load<double>();
+                    case value_date: return os << v.load<date_t>();
+                    case value_datetime: return os << v.load<datetime_t>();
+                    case value_time: write_time(os, std::chrono::microseconds(v.load<int64_t>())); return os;
+                }
+                return os << v.view();
+            }
+
+        private:
+            enum storage_type : uint8_t {
+                store_null,
+                store_scalar,
+                store_inline, // length in the high bits of info_
+                store_heap,
+                store_borrowed,
+            };
+
+            struct external_type {
+                const char* p;
+                size_t n;
+            };
+
+            alignas(8) unsigned char data_[inline_size];
+            uint8_t type_;
+            uint8_t info_;
+
+            storage_type storage() const {return static_cast<storage_type>(info_ & 7);}
+
+            template<class T> void store(T v, value_type type) {
+                static_assert(sizeof(T) <= inline_size && std::is_trivially_copyable<T>::value);
+                memcpy(data_, &v, sizeof(T));
+                type_ = type;
+                info_ = store_scalar;
+            }
+
+            template<class T> T load() const {
+                T v;
+                memcpy(static_cast<void*>(&v), data_, sizeof(T));
+                return v;
+            }
+
+            template<class T> T scalar(value_type type, const char* name) const {
+                if (type_ != type) mismatch(name);
+                return load<T>();
+            }
+
+            void copy(string_view s, value_type type) {
+                if (s.size() <= inline_size) {
+                    memcpy(data_, s.data(), s.size());
+                    type_ = type;
+                    info_ = store_inline | s.size() << 3;
+                } else {
+                    auto p = new char[s.size()];
+                    memcpy(p, s.data(), s.size());
+                    set_external(p, s.size(), type, store_heap);
+                }
+            }
+
+            void set_external(const char* p, size_t n, value_type type, storage_type storage) {
+                store(external_type{p, n}, type);
+                info_ = storage;
+            }
+
+            external_type external() const {return load<external_type>();}
+
+            void mismatch(const char* expected) const {
+                front::raise_error(std::string("value: not ") + expected + ", type", static_cast<int>(type_));
+            }
+
+            static bool same_date(const date_t& a, const date_t& b) {
+                return a.year() == b.year() && a.month() == b.month() && a.day() == b.day();
+            }
+    };
+
+    static_assert(sizeof(value) == 32, "value is meant to be 32 bytes");
+
+    namespace front {
+
+        template<class T, class D> value field_read(const field<D>& f) {
+            if constexpr (has_field_type<D,T>::value) return value(f.template as<T>());
+            else raise_error("value: unsupported type", f.type());
+            return value();
+        }
+
+        // a value that may borrow the field's bytes, valid until the row moves on
+        template<class D> value field_view(const field<D>& f) {
+            if (f.is_null()) return value();
+            using string_view = std::experimental::string_view;
+            switch(f.type()) {
+                case value_int: return value(f.template as<int>());
+                case value_int64: return field_read<int64_t>(f);
+                case value_double: return field_read<double>(f);
+                case value_date: return value(f.template as<date_t>());
+                case value_datetime: return field_read<datetime_t>(f);
+                case value_time: return field_read<std::chrono::microseconds>(f);
+                case value_string:
+                case value_blob:
+                case value_decimal: return value::borrow(f.template as<string_view>(), f.type());
+                default: break;
+            }
+            raise_error("value: unsupported type", f.type());
+            return value();
+        }
+
+        // an owning copy of the field
+        template<class D> value to_value(const field<D>& f) {
+            auto v = field_view(f);
+            return value(v);
+        }
+
+    }
+
+    class row_snapshot {
+        public:
+            row_snapshot():size_(0) {}
+
+            template<class D> explicit row_snapshot(front::row<D> r):size_(0) {
+                build(r.width(), [&r](size_t i) {return front::field_view(r[i]);});
+            }
+
+            row_snapshot(const row_snapshot& other):size_(0) {
+                build(other.size_, [&other](size_t i) {return other[i].ref();});
+            }
+
+            row_snapshot(row_snapshot&& other) noexcept:
+                size_(other.size_),
+                data_(std::move(other.data_)) {
+                    other.size_ = 0;
+                }
+
+            row_snapshot& operator=(row_snapshot other) noexcept {
+                std::swap(size_, other.size_);
+                std::swap(data_, other.data_);
+                return *this;
+            }
+
+            size_t size() const {return size_;}
+            bool empty() const {return size_ == 0;}
+
+            const value& operator[](size_t idx) const {return begin()[idx];}
+            const value* begin() const {return reinterpret_cast<const value*>(data_.get());}
+            const value* end() const {return begin() + size_;}
+
+        private:
+            size_t size_;
+            std::unique_ptr<char[]> data_;
+
+            /*
+               get(i) is called twice per column, once to size the payload;
+               values in the snapshot never own memory so need no destructor
+             */
+            template<class G> void build(size_t n, G get) {
+                size_t payload = 0;
+                for(size_t i = 0; i != n; ++i) {
+                    auto v = get(i);
+                    if (v.is_external()) payload += v.view().size();
+                }
+
+                data_.reset(new char[n * sizeof(value) + payload]);
+                auto values = reinterpret_cast<value*>(data_.get());
+                auto p = data_.get() + n * sizeof(value);
+                for(size_t i = 0; i != n; ++i) {
+                    auto v = get(i);
+                    if (v.is_external()) {
+                        auto s = v.view();
+                        memcpy(p, s.data(), s.size());
+                        new (values + i) value(value::borrow(value::string_view(p, s.size()), v.type()));
+                        p += s.size();
+                    } else {
+                        new (values + i) value(std::move(v));
+                    }
+                }
+                size_ = n;
+            }
+    };
+
+    inline std::ostream& operator<<(std::ostream& os, const row_snapshot& r) {
+        for(size_t i = 0; i != r.size(); ++i) {
+            if (i) os << ",";
+            os << r[i];
+        }
+        return os;
+    }
+
+}
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef CPPSTDDB_WRITE_QUEUE_H
+#define CPPSTDDB_WRITE_QUEUE_H
+
+#include <cppstddb/front.h>
+#include <cppstddb/statement_def.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+   Group commit for writes from many threads.  Producers push statement_def
+   writes (insert, update, delete) with their parameters and get a future
+   each; a writer thread with its own connection runs them in transactions
+   of up to max_batch writes, waiting at most max_delay after the first for
+   a batch to fill.  One writer means no lock contention between writers
+   (no SQLITE_BUSY), and one commit covers many rows.
+
+     write_queue q(db);
+     auto done = q.push<insert_score>("Turing", 90);
+     done.get(); // committed, or rethrows the write's error
+
+   Pushing is a compare and swap on a lock free stack, the writer takes the
+   whole stack at once; a producer only takes the lock to wake the writer.
+   A write that fails is rolled back alone: the batch is rolled back and
+   run again without it.  The destructor commits what is queued.
+ */
+
+namespace cppstddb { namespace front {
+
+    struct write_queue_stats {
+        uint64_t writes = 0;
+        uint64_t batches = 0;
+        uint64_t failed = 0;
+        size_t max_batch = 0;   // largest committed
+    };
+
+    template<class D> class write_queue {
+        public:
+            using database_type = D;
+            using database_t = basic_database<database_type>;
+            using connection_t = connection<database_type>;
+            using statement_t = statement<database_type>;
+            using statement_type = typename database_type::statement;
+            using clock = std::chrono::steady_clock;
+
+            write_queue(
+                    database_t db,
+                    size_t max_batch = 256,
+                    std::chrono::microseconds max_delay = std::chrono::milliseconds(1)):
+                con_(db.connection()),
+                max_batch_(std::max<size_t>(max_batch, 1)),
+                max_delay_(max_delay),
+                head_(nullptr),
+                pending_(0),
+                wake_at_(never),
+                stop_(false) {
+                    thread_ = std::thread([this] {run();});
+                }
+
+            ~write_queue() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stop_ = true;
+                }
+                cv_.notify_all();
+                thread_.join();
+            }
+
+            write_queue(const write_queue&) = delete;
+            write_queue& operator=(const write_queue&) = delete;
+
+            // safe from any thread, args are copied into the queue
+            template<class Def, class... A> std::future<void> push(A&&... args) {
+                static_assert(placeholder_count(Def::sql) == Def::param_count,
+                        "sql placeholders do not match the statement parameters");
+                static_assert(sizeof...(A) == Def::param_count, "wrong number of parameters");
+
+                auto w = new typed_write<Def>(std::forward<A>(args)...);
+                auto done = w->done.get_future();
+
+                // counted before it can be taken, so take() never counts below zero
+                auto n = pending_.fetch_add(1) + 1;
+                w->next = head_.load(std::memory_order_relaxed);
+                while (!head_.compare_exchange_weak(w->next, w, std::memory_order_release, std::memory_order_relaxed)) {}
+
+                if (n >= wake_at_.load()) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    cv_.notify_one();
+                }
+                return done;
+            }
+
+            write_queue_stats stats() const {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                return stats_;
+            }
+
+        private:
+            struct write {
+                write* next = nullptr;
+                const char* sql;
+                std::promise<void> done;
+                write(const char* s):sql(s) {}
+                virtual ~write() {}
+                virtual void bind(statement_type& s) = 0;
+            };
+
+            template<class Def, class Params = typename Def::params_type> struct typed_write;
+
+            template<class Def, class... P> struct typed_write<Def, params<P...>> : write {
+                std::tuple<P...> args;
+                template<class... A> typed_write(A&&... a):write(Def::sql),args(std::forward<A>(a)...) {}
+                void bind(statement_type& s) {
+                    std::apply([&s](const P&... p) {bind_params<database_type>(s, p...);}, args);
+                }
+            };
+
+            using write_ptr = std::unique_ptr<write>;
+            static constexpr size_t never = std::numeric_limits<size_t>::max();
+
+            connection_t con_; // the writer thread's
+            size_t max_batch_;
+            std::chrono::microseconds max_delay_;
+
+            std::atomic<write*> head_;      // pushed, newest first
+            std::atomic<size_t> pending_;   // pushed and not yet taken
+            std::atomic<size_t> wake_at_;   // pending count that wakes the writer
+            bool stop_;
+            std::mutex mutex_;
+            std::condition_variable cv_;
+
+            mutable std::mutex stats_mutex_;
+            write_queue_stats stats_;
+
+            // writer thread only
+            std::deque<write_ptr> ready_;
+            std::unordered_map<const char*, statement_t> statements_;
+            std::thread thread_;
+
+            void run() {
+                std::vector<write_ptr> batch;
+                while (next_batch(batch)) commit(batch);
+            }
+
+            // oldest first, false once stopped with nothing left
+            bool next_batch(std::vector<write_ptr>& batch) {
+                for(take(); ready_.empty(); take()) {
+                    if (stopped()) return false;
+                    // a write counted but not yet on the stack wakes this early, it is taken next round
+                    wait(1, clock::time_point::max());
+                }
+                if (ready_.size() < max_batch_ && max_delay_.count()) {
+                    wait(max_batch_ - ready_.size(), clock::now() + max_delay_);
+                    take();
+                }
+                auto n = std::min(ready_.size(), max_batch_);
+                for(size_t i = 0; i != n; ++i) {
+                    batch.push_back(std::move(ready_.front()));
+                    ready_.pop_front();
+                }
+                return true;
+            }
+
+            void take() {
+                auto w = head_.exchange(nullptr, std::memory_order_acquire);
+                size_t n = 0;
+                write* prev = nullptr;
+                for(; w; ++n) {
+                    auto next = w->next;
+                    w->next = prev;
+                    prev = w;
+                    w = next;
+                }
+                for(; prev; prev = prev->next) ready_.emplace_back(prev);
+                pending_ -= n;
+            }
+
+            bool stopped() {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return stop_ && !pending_.load();
+            }
+
+            // until want more writes are pushed, stop or until
+            void wait(size_t want, clock::time_point until) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_at_ = want;
+                auto ready = [this, want] {return pending_.load() >= want || stop_;};
+                if (until == clock::time_point::max()) cv_.wait(lock, ready);
+                else cv_.wait_until(lock, until, ready);
+                wake_at_ = never;
+            }
+
+            void commit(std::vector<write_ptr>& batch) {
+                while (!batch.empty()) {
+                    size_t i = never; // never: begin or commit failed
+                    try {
+                        con_.data_->begin();
+                        for(i = 0; i != batch.size(); ++i) {
+                            auto& w = *batch[i];
+                            auto& s = prepared(w.sql);
+                            w.bind(*s.data_);
+                            s.query();
+                            s.reset();
+                        }
+                        i = never;
+                        con_.data_->commit();
+                    } catch (...) {
+                        auto e = std::current_exception();
+                        try {
+                            con_.data_->rollback();
+                        } catch (...) {
+                            DB_WARN("write_queue: rollback failed");
+                        }
+                        if (i == never) {
+                            fail(batch.begin(), batch.end(), e);
+                            batch.clear();
+                        } else {
+                            fail(batch.begin() + i, batch.begin() + i + 1, e);
+                            batch.erase(batch.begin() + i);
+                        }
+                        continue;
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lock(stats_mutex_);
+                        stats_.writes += batch.size();
+                        ++stats_.batches;
+                        stats_.max_batch = std::max(stats_.max_batch, batch.size());
+                    }
+                    for(auto& w : batch) w->done.set_value();
+                    batch.clear();
+                }
+            }
+
+            template<class I> void fail(I first, I last, std::exception_ptr e) {
+                {
+                    std::lock_guard<std::mutex> lock(stats_mutex_);
+                    stats_.failed += last - first;
+                }
+                for(; first != last; ++first) (*first)->done.set_exception(e);
+            }
+
+            statement_t& prepared(const char* sql) {
+                auto i = statements_.find(sql);
+                if (i == statements_.end()) i = statements_.emplace(sql, con_.statement(sql)).first;
+                return i->second;
+            }
+    };
+
+}}
+
+#endif
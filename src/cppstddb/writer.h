@@ -0,0 +1,540 @@
+#ifndef CPPSTDDB_WRITER_H
+#define CPPSTDDB_WRITER_H
+
+#include <cppstddb/front.h>
+#include <cppstddb/database_error.h>
+#include <cppstddb/log.h>
+#include <vector>
+#include <string>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <cmath>
+#include <chrono>
+#include <cerrno>
+#include <unistd.h>
+
+/*
+   High throughput CSV (RFC 4180) and JSON lines writers for rowsets.
+
+   Per column encoders are resolved once from the rowset binds (and again
+   when a driver with per row types reports a different one), escaping
+   scans a word at a time, numbers and dates are formatted without iostreams,
+   and output is staged in a large buffer that is written straight to a
+   file descriptor.
+ */
+
+namespace cppstddb {
+
+    class fd_buffer {
+        public:
+            static const size_t default_size = 1 << 20;
+
+            fd_buffer(int fd, size_t size = default_size):
+                fd_(fd),
+                buf_(size),
+                pos_(0) {}
+
+            ~fd_buffer() {
+                try {
+                    flush();
+                } catch (database_error& e) {
+                    DB_ERROR("~fd_buffer: " << e.what());
+                }
+            }
+
+            fd_buffer(const fd_buffer&) = delete;
+            fd_buffer& operator=(const fd_buffer&) = delete;
+
+            // make room for n contiguous bytes, use commit() for what was used
+            char* reserve(size_t n) {
+                if (buf_.size() - pos_ < n) {
+                    flush();
+                    if (buf_.size() < n) buf_.resize(n);
+                }
+                return &buf_[pos_];
+            }
+
+            void commit(size_t n) {pos_ += n;}
+
+            void put(char c) {
+                if (pos_ == buf_.size()) flush();
+                buf_[pos_++] = c;
+            }
+
+            void append(const char* s, size_t n) {
+                if (buf_.size() - pos_ < n) {
+                    flush();
+                    if (n >= buf_.size()) {
+                        write_fd(s, n);
+                        return;
+                    }
+                }
+                memcpy(&buf_[pos_], s, n);
+                pos_ += n;
+            }
+
+            void flush() {
+                if (!pos_) return;
+                write_fd(buf_.data(), pos_);
+                pos_ = 0;
+            }
+
+        private:
+            int fd_;
+            std::vector<char> buf_;
+            size_t pos_;
+
+            void write_fd(const char* s, size_t n) {
+                while (n) {
+                    auto ret = ::write(fd_, s, n);
+                    if (ret < 0) {
+                        if (errno == EINTR) continue;
+                        throw database_error("fd_buffer: write failed", errno, strerror(errno));
+                    }
+                    s += ret;
+                    n -= ret;
+                }
+            }
+    };
+
+    namespace impl {
+
+        // word at a time (SWAR) byte tests, see "bit twiddling hacks"
+
+        const uint64_t swar_ones = 0x0101010101010101ULL;
+        const uint64_t swar_highs = 0x8080808080808080ULL;
+
+        inline uint64_t swar_has_zero(uint64_t x) {
+            return (x - swar_ones) & ~x & swar_highs;
+        }
+
+        inline uint64_t swar_has_byte(uint64_t x, unsigned char c) {
+            return swar_has_zero(x ^ (swar_ones * c));
+        }
+
+        inline uint64_t swar_has_less(uint64_t x, unsigned char n) {
+            return (x - swar_ones * n) & ~x & swar_highs;
+        }
+
+        inline bool csv_special(unsigned char c) {
+            return c == '"' || c == ',' || c == '\n' || c == '\r';
+        }
+
+        inline bool json_special(unsigned char c) {
+            return c == '"' || c == '\\' || c < 0x20;
+        }
+
+        // index of first byte needing csv quoting, or n
+        inline size_t csv_find_special(const char* s, size_t n) {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                uint64_t x;
+                memcpy(&x, s + i, 8);
+                if (swar_has_byte(x,'"') | swar_has_byte(x,',') |
+                        swar_has_byte(x,'\n') | swar_has_byte(x,'\r')) break;
+            }
+            for (; i != n; ++i) if (csv_special(s[i])) return i;
+            return n;
+        }
+
+        // index of first byte needing json escaping at or after i, or n
+        inline size_t json_find_special(const char* s, size_t i, size_t n) {
+            for (; i + 8 <= n; i += 8) {
+                uint64_t x;
+                memcpy(&x, s + i, 8);
+                if (swar_has_byte(x,'"') | swar_has_byte(x,'\\') | swar_has_less(x,0x20)) break;
+            }
+            for (; i != n; ++i) if (json_special(s[i])) return i;
+            return n;
+        }
+
+        inline void write_int(fd_buffer& buf, int64_t v) {
+            const size_t max_digits = 20;
+            auto p = buf.reserve(max_digits);
+            auto r = std::to_chars(p, p + max_digits, v);
+            buf.commit(r.ptr - p);
+        }
+
+        inline void write_double(fd_buffer& buf, double v) {
+            const size_t max_chars = 32; // shortest round trip form
+            auto p = buf.reserve(max_chars);
+            auto r = std::to_chars(p, p + max_chars, v);
+            buf.commit(r.ptr - p);
+        }
+
+        inline char* put_digits(char* p, int v, int width) {
+            for (int i = width - 1; i >= 0; --i, v /= 10) p[i] = '0' + v % 10;
+            return p + width;
+        }
+
+        inline void write_date(fd_buffer& buf, const date_t& d) {
+            if (d.year() < 0 || d.year() > 9999) {
+                // out of iso range, fall back to plain numbers
+                write_int(buf, d.year());
+                buf.put('-');
+                write_int(buf, d.month());
+                buf.put('-');
+                write_int(buf, d.day());
+                return;
+            }
+            auto p = buf.reserve(10);
+            auto e = put_digits(p, d.year(), 4);
+            *e++ = '-';
+            e = put_digits(e, d.month(), 2);
+            *e++ = '-';
+            e = put_digits(e, d.day(), 2);
+            buf.commit(e - p);
+        }
+
+        inline void write_datetime(fd_buffer& buf, const datetime_t& d) {
+            write_date(buf, d.date());
+            auto p = buf.reserve(16);
+            auto e = p;
+            *e++ = ' ';
+            e = put_digits(e, d.hour(), 2);
+            *e++ = ':';
+            e = put_digits(e, d.minute(), 2);
+            *e++ = ':';
+            e = put_digits(e, d.second(), 2);
+            if (d.microsecond()) {
+                *e++ = '.';
+                e = put_digits(e, d.microsecond(), 6);
+            }
+            buf.commit(e - p);
+        }
+
+        inline void write_time(fd_buffer& buf, std::chrono::microseconds t) {
+            using namespace std::chrono;
+            if (t.count() < 0) {
+                buf.put('-');
+                t = -t;
+            }
+            auto h = duration_cast<hours>(t);
+            auto m = duration_cast<minutes>(t - h);
+            auto s = duration_cast<seconds>(t - h - m);
+            auto us = (t - h - m - s).count();
+            if (h.count() > 99) {
+                write_int(buf, h.count());
+            } else {
+                put_digits(buf.reserve(2), h.count(), 2);
+                buf.commit(2);
+            }
+            auto p = buf.reserve(14);
+            auto e = p;
+            *e++ = ':';
+            e = put_digits(e, m.count(), 2);
+            *e++ = ':';
+            e = put_digits(e, s.count(), 2);
+            if (us) {
+                *e++ = '.';
+                e = put_digits(e, us, 6);
+            }
+            buf.commit(e - p);
+        }
+
+        inline void write_csv_string(fd_buffer& buf, const char* s, size_t n) {
+            if (csv_find_special(s,n) == n) {
+                buf.append(s,n);
+                return;
+            }
+            buf.put('"');
+            while (n) {
+                auto q = static_cast<const char*>(memchr(s, '"', n));
+                if (!q) {
+                    buf.append(s,n);
+                    break;
+                }
+                size_t k = q - s + 1;
+                buf.append(s,k);
+                buf.put('"');
+                s += k;
+                n -= k;
+            }
+            buf.put('"');
+        }
+
+        inline void write_json_string(fd_buffer& buf, const char* s, size_t n) {
+            static const char hex[] = "0123456789abcdef";
+            buf.put('"');
+            size_t i = 0;
+            while (i != n) {
+                auto j = json_find_special(s, i, n);
+                buf.append(s + i, j - i);
+                if (j == n) break;
+                unsigned char c = s[j];
+                switch (c) {
+                    case '"': buf.append("\\\"",2); break;
+                    case '\\': buf.append("\\\\",2); break;
+                    case '\n': buf.append("\\n",2); break;
+                    case '\r': buf.append("\\r",2); break;
+                    case '\t': buf.append("\\t",2); break;
+                    default: {
+                                 char u[6] = {'\\','u','0','0',hex[c >> 4],hex[c & 0xf]};
+                                 buf.append(u,6);
+                             }
+                }
+                i = j + 1;
+            }
+            buf.put('"');
+        }
+
+        // json has no bytes, blobs go out as hex strings
+        inline void write_json_hex(fd_buffer& buf, const char* s, size_t n) {
+            static const char hex[] = "0123456789abcdef";
+            auto p = buf.reserve(2 * n + 2), e = p;
+            *e++ = '"';
+            for(size_t i = 0; i != n; ++i) {
+                unsigned char c = s[i];
+                *e++ = hex[c >> 4];
+                *e++ = hex[c & 0xf];
+            }
+            *e++ = '"';
+            buf.commit(e - p);
+        }
+
+        // drivers with per row types (sqlite) provide row_type(col)
+        template<class T, class = void> struct has_row_type : std::false_type {};
+        template<class T> struct has_row_type<T,
+            decltype(void(std::declval<const T&>().row_type(0)))> : std::true_type {};
+
+        inline std::string json_key(char lead, std::experimental::string_view name) {
+            static const char hex[] = "0123456789abcdef";
+            std::string s;
+            s += lead;
+            s += '"';
+            for(unsigned char c : name) {
+                if (c == '"' || c == '\\') {
+                    s += '\\';
+                    s += c;
+                } else if (c < 0x20) {
+                    s += "\\u00";
+                    s += hex[c >> 4];
+                    s += hex[c & 0xf];
+                } else s += c;
+            }
+            s += "\":";
+            return s;
+        }
+
+        template<class F> struct encoders {
+            using string_view = std::experimental::string_view;
+            using database_type = typename F::database_type;
+            using encoder = void (*)(fd_buffer& buf, const F& f);
+
+            template<class T> static constexpr bool reads() {
+                return front::has_field_type<database_type,T>::value;
+            }
+
+            static void csv_int(fd_buffer& buf, const F& f) {write_int(buf, f.template as<int>());}
+            static void csv_int64(fd_buffer& buf, const F& f) {write_int(buf, f.template as<int64_t>());}
+            static void csv_double(fd_buffer& buf, const F& f) {write_double(buf, f.template as<double>());}
+            static void csv_date(fd_buffer& buf, const F& f) {write_date(buf, f.template as<date_t>());}
+            static void csv_datetime(fd_buffer& buf, const F& f) {write_datetime(buf, f.template as<datetime_t>());}
+            static void csv_time(fd_buffer& buf, const F& f) {write_time(buf, f.template as<std::chrono::microseconds>());}
+
+            // decimals keep the driver's exact text
+            static void decimal(fd_buffer& buf, const F& f) {
+                auto s = f.template as<string_view>();
+                buf.append(s.data(), s.size());
+            }
+
+            static void csv_string(fd_buffer& buf, const F& f) {
+                auto s = f.template as<string_view>();
+                write_csv_string(buf, s.data(), s.size());
+            }
+
+            static void json_int(fd_buffer& buf, const F& f) {write_int(buf, f.template as<int>());}
+            static void json_int64(fd_buffer& buf, const F& f) {write_int(buf, f.template as<int64_t>());}
+            static void json_double(fd_buffer& buf, const F& f) {
+                auto v = f.template as<double>();
+                if (std::isfinite(v)) write_double(buf, v);
+                else buf.append("null",4);
+            }
+            static void json_date(fd_buffer& buf, const F& f) {
+                buf.put('"');
+                write_date(buf, f.template as<date_t>());
+                buf.put('"');
+            }
+            static void json_datetime(fd_buffer& buf, const F& f) {
+                buf.put('"');
+                write_datetime(buf, f.template as<datetime_t>());
+                buf.put('"');
+            }
+            static void json_time(fd_buffer& buf, const F& f) {
+                buf.put('"');
+                write_time(buf, f.template as<std::chrono::microseconds>());
+                buf.put('"');
+            }
+            static void json_string(fd_buffer& buf, const F& f) {
+                auto s = f.template as<string_view>();
+                write_json_string(buf, s.data(), s.size());
+            }
+            static void json_blob(fd_buffer& buf, const F& f) {
+                auto s = f.template as<string_view>();
+                write_json_hex(buf, s.data(), s.size());
+            }
+
+            // csv blobs go out as strings, escaped like text
+            static encoder csv(value_type type) {
+                switch(type) {
+                    case value_int: return csv_int;
+                    case value_string: return csv_string;
+                    case value_blob: return csv_string;
+                    case value_date: return csv_date;
+                    case value_int64: if constexpr (reads<int64_t>()) return csv_int64; break;
+                    case value_double: if constexpr (reads<double>()) return csv_double; break;
+                    case value_decimal: return decimal;
+                    case value_datetime: if constexpr (reads<datetime_t>()) return csv_datetime; break;
+                    case value_time: if constexpr (reads<std::chrono::microseconds>()) return csv_time; break;
+                    default: break;
+                }
+                front::raise_error("csv: unsupported type", type);
+                return nullptr;
+            }
+
+            static encoder json(value_type type) {
+                switch(type) {
+                    case value_int: return json_int;
+                    case value_string: return json_string;
+                    case value_blob: return json_blob;
+                    case value_date: return json_date;
+                    case value_int64: if constexpr (reads<int64_t>()) return json_int64; break;
+                    case value_double: if constexpr (reads<double>()) return json_double; break;
+                    case value_decimal: return decimal;
+                    case value_datetime: if constexpr (reads<datetime_t>()) return json_datetime; break;
+                    case value_time: if constexpr (reads<std::chrono::microseconds>()) return json_time; break;
+                    default: break;
+                }
+                front::raise_error("json: unsupported type", type);
+                return nullptr;
+            }
+        };
+
+    }
+
+    template<class R> class csv_writer {
+        public:
+            using rowset_t = R;
+            using database_type = typename rowset_t::database_type;
+            using row_t = front::row<database_type>;
+            using field_t = front::field<database_type>;
+            using encoders = impl::encoders<field_t>;
+            using encoder = typename encoders::encoder;
+            static constexpr bool row_types = impl::has_row_type<typename rowset_t::rowset_type>::value;
+
+            csv_writer(int fd, size_t buffer_size = fd_buffer::default_size):
+                buf_(fd, buffer_size) {}
+
+            void write(rowset_t& rows, bool header = true) {
+                auto width = rows.width();
+                std::vector<encoder> encode(width);
+                std::vector<value_type> types(width);
+                for(int c = 0; c != width; ++c) {
+                    types[c] = rows.data_->binds[c].type;
+                    encode[c] = encoders::csv(types[c]);
+                }
+
+                if (header) {
+                    for(int c = 0; c != width; ++c) {
+                        if (c) buf_.put(',');
+                        auto n = rows.name(c);
+                        impl::write_csv_string(buf_, n.data(), n.size());
+                    }
+                    buf_.append("\r\n",2);
+                }
+
+                // one row object for the whole scan (avoids per row ref counting)
+                row_t row(rows);
+                auto& r = row.rows_;
+                while (!r.empty()) {
+                    for(int c = 0; c != width; ++c) {
+                        if (c) buf_.put(',');
+                        auto f = row[c];
+                        if (f.is_null()) continue; // null: empty field
+                        if constexpr (row_types) {
+                            // the column type is only a guess, follow the row
+                            auto t = r.data_->row_type(c);
+                            if (t != types[c]) encode[c] = encoders::csv(types[c] = t);
+                        }
+                        encode[c](buf_, f);
+                    }
+                    buf_.append("\r\n",2);
+                    r.next();
+                }
+                rows = r;
+                buf_.flush();
+            }
+
+        private:
+            fd_buffer buf_;
+    };
+
+    template<class R> class json_lines_writer {
+        public:
+            using rowset_t = R;
+            using database_type = typename rowset_t::database_type;
+            using row_t = front::row<database_type>;
+            using field_t = front::field<database_type>;
+            using encoders = impl::encoders<field_t>;
+            using encoder = typename encoders::encoder;
+            static constexpr bool row_types = impl::has_row_type<typename rowset_t::rowset_type>::value;
+
+            json_lines_writer(int fd, size_t buffer_size = fd_buffer::default_size):
+                buf_(fd, buffer_size) {}
+
+            void write(rowset_t& rows) {
+                auto width = rows.width();
+                std::vector<encoder> encode(width);
+                std::vector<value_type> types(width);
+                std::vector<std::string> keys(width);
+
+                for(int c = 0; c != width; ++c) {
+                    types[c] = rows.data_->binds[c].type;
+                    encode[c] = encoders::json(types[c]);
+
+                    // pre-encode '{"name":' / ',"name":' once per column
+                    keys[c] = impl::json_key(c ? ',' : '{', rows.name(c));
+                }
+
+                row_t row(rows);
+                auto& r = row.rows_;
+                while (!r.empty()) {
+                    for(int c = 0; c != width; ++c) {
+                        buf_.append(keys[c].data(), keys[c].size());
+                        auto f = row[c];
+                        if (f.is_null()) {
+                            buf_.append("null",4);
+                            continue;
+                        }
+                        if constexpr (row_types) {
+                            auto t = r.data_->row_type(c);
+                            if (t != types[c]) encode[c] = encoders::json(types[c] = t);
+                        }
+                        encode[c](buf_, f);
+                    }
+                    if (!width) buf_.put('{');
+                    buf_.append("}\n",2);
+                    r.next();
+                }
+                rows = r;
+                buf_.flush();
+            }
+
+        private:
+            fd_buffer buf_;
+    };
+
+    template<class R> void write_csv(R& rows, int fd, bool header = true) {
+        csv_writer<R>(fd).write(rows, header);
+    }
+
+    template<class R> void write_json_lines(R& rows, int fd) {
+        json_lines_writer<R>(fd).write(rows);
+    }
+
+}
+
+#endif
+
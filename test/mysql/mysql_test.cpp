@@ -4,10 +4,155 @@
 
 using namespace std;
 
+namespace cppstddb {
+
+    void statement_reuse_test(const std::string& uri) {
+        test_header("statement_reuse_test");
+        auto db = mysql::database(uri);
+        auto stmt = db.connection().statement("select name,score from score");
+        for(int i = 0; i != 100; ++i) {
+            auto r = stmt.query().rows();
+            auto sum = std::accumulate(r.begin(), r.end(), 0, [](int sum, auto row) {
+                    return sum + row[1].template as<int>();});
+            assertion(sum == 194);
+        }
+    }
+
+    void load_data_test(const std::string& uri) {
+        test_header("load_data_test");
+        auto db = mysql::database(uri);
+        recreate_score_table(db, false);
+
+        // from a container of tuples
+        std::vector<std::tuple<std::string,int,std::string>> rows = {
+            {"Knuth", 62, "2016-01-01"},
+            {"Hopper", 48, "2016-02-02"}};
+        auto n = mysql::load_data(db.connection(), "score", rows);
+        assertion(n == 2);
+
+        // from a generator
+        int i = 0;
+        n = mysql::load_data(db.connection(), "score (name,score)", [&i](mysql::infile_row& row) {
+                if (i == 1000) return false;
+                row << "gen\t" << i++;
+                return true;
+                });
+        assertion(n == 1000);
+
+        auto r = db.statement("select count(*) from score").query().rows();
+        assertion(r.front()[0].as<int>() == 1002);
+    }
+
+    void long_text_test(const std::string& uri) {
+        test_header("long_text_test");
+        auto db = mysql::database(uri);
+        drop_table(db, "long_text");
+        db.query("create table long_text (id integer, t longtext)");
+        db.query("insert into long_text values (1, 'short'), (2, repeat('x', 100000)), (3, 'tail')");
+
+        const size_t sizes[] = {5, 100000, 4};
+        int i = 0;
+        auto r = db.statement("select id, t from long_text order by id").query().rows();
+        for(auto row : r) {
+            auto s = row[1].str();
+            assertion(s.size() == sizes[i++]);
+        }
+        assertion(i == 3);
+    }
+
+    void types_test(const std::string& uri) {
+        test_header("types_test");
+        auto db = mysql::database(uri);
+        drop_table(db, "typed");
+        db.query("create table typed ("
+                "b bigint, u bigint unsigned, t tinyint, d double, n decimal(10,3), "
+                "dt datetime(6), tm time, bl blob, j json, bt bit(12))");
+        db.query("insert into typed values ("
+                "1099511627776, 18446744073709551615, -5, 2.5, -12.345, "
+                "'2016-01-02 03:04:05.000006', '-27:30:01', x'00ff', '{\"a\":1}', b'101000000001')");
+        db.query("insert into typed values (null, null, null, null, null, null, null, null, null, null)");
+
+        // the binary (prepared) and text (direct) protocols read the same values
+        for(auto mode : {execution::prepared, execution::direct}) {
+            auto r = db.statement("select * from typed", mode).query().rows();
+            auto row = r.front();
+            assertion(row[0].type() == value_int64 && row[0].as<long long>() == 1099511627776LL);
+            assertion(row[1].as<unsigned long long>() == 18446744073709551615ULL);
+            assertion(row[2].type() == value_int && row[2].as<int>() == -5);
+            assertion(row[3].type() == value_double && row[3].as<double>() == 2.5);
+            auto n = row[4].as<decimal_t>();
+            assertion(row[4].type() == value_decimal && n.value() == -12345 && n.scale() == 3);
+            auto dt = row[5].as<datetime_t>();
+            assertion(dt.year() == 2016 && dt.second() == 5 && dt.microsecond() == 6);
+            using namespace std::chrono;
+            assertion(row[6].as<microseconds>() == -(hours(27) + minutes(30) + seconds(1)));
+            auto bl = row[7].as<std::vector<unsigned char>>();
+            assertion(row[7].type() == value_blob && bl.size() == 2 && bl[1] == 0xff);
+            assertion(row[8].str() == "{\"a\": 1}");
+            assertion(row[9].type() == value_int64 && row[9].as<long long>() == 0xa01);
+
+            r.next();
+            for(int c = 0; c != 10; ++c) assertion(row[c].is_null());
+
+            // wider than decimal_t: printed as the server's text
+            auto w = db.statement("select cast('12345678901234567890.0123456789' as decimal(30,10))", mode).query().rows();
+            std::ostringstream os;
+            os << w.front()[0];
+            assertion(os.str() == "12345678901234567890.0123456789");
+            assertion(w.front()[0].as<double>() > 1.2e19);
+        }
+    }
+
+    void lob_test(const std::string& uri) {
+        test_header("lob_test");
+        auto db = mysql::database(uri);
+        drop_table(db, "lob");
+        db.query("create table lob (id integer, b longblob)");
+
+        const size_t size = 3 << 20;
+        size_t produced = 0;
+        auto insert = db.connection().statement("insert into lob values (1, ?)");
+        insert.write_lob(0, [&produced, size](char* buf, size_t n) {
+                n = std::min(n, size - produced);
+                for(size_t i = 0; i != n; ++i) buf[i] = static_cast<char>((produced + i) % 251);
+                produced += n;
+                return n;
+                });
+        insert.query();
+
+        size_t offset = 0;
+        bool same = true;
+        auto r = db.statement("select b from lob where id = 1").query().rows();
+        r.front()[0].read_chunks([&offset, &same](const char* p, size_t n) {
+                for(size_t i = 0; i != n; ++i) same &= p[i] == static_cast<char>((offset + i) % 251);
+                offset += n;
+                });
+        assertion(same && offset == size);
+    }
+
+    struct insert_score : statement_def<params<std::string,std::optional<int>>, results<>> {
+        static constexpr const char* sql = "insert into score(name,score) values(?,?)";
+    };
+
+    struct scores_above : statement_def<params<int>, results<std::string,std::optional<int>>> {
+        static constexpr const char* sql = "select name,score from score where score > ? order by score";
+    };
+
+}
+
 int main() {
     try {
 		using namespace cppstddb;
         test_all<mysql::database>(test_uri("mysql"));
+        // a killed sleep() returns 1 without an error, benchmark() fails
+        timeout_test<mysql::database>(test_uri("mysql"), "select benchmark(10000000000, md5('cppstddb'))");
+        statement_reuse_test(test_uri("mysql"));
+        load_data_test(test_uri("mysql") + "&local_infile=true");
+        long_text_test(test_uri("mysql"));
+        types_test(test_uri("mysql"));
+        lob_test(test_uri("mysql"));
+        typed_statement_test<mysql::database, insert_score, scores_above>(test_uri("mysql"));
+        write_queue_test<mysql::database, insert_score>(test_uri("mysql"));
     } catch (cppstddb::database_error &e) {
         cppstddb::vertical_print(cout, e);
     } catch (exception &e) {
@@ -15,4 +160,3 @@ int main() {
     }
     return 0;
 }
-
@@ -4,10 +4,59 @@
 
 using namespace std;
 
+namespace cppstddb {
+
+	void large_object_test(const std::string& uri) {
+		test_header("large_object_test");
+		auto db = postgres::database(uri);
+		auto con = db.connection();
+
+		const size_t size = 3 << 20;
+		size_t produced = 0;
+		auto oid = postgres::write_large_object(con, [&produced, size](char* buf, size_t n) {
+				n = std::min(n, size - produced);
+				for(size_t i = 0; i != n; ++i) buf[i] = static_cast<char>((produced + i) % 251);
+				produced += n;
+				return n;
+				});
+
+		size_t offset = 0;
+		bool same = true;
+		postgres::read_large_object(con, oid, [&offset, &same](const char* p, size_t n) {
+				for(size_t i = 0; i != n; ++i) same &= p[i] == static_cast<char>((offset + i) % 251);
+				offset += n;
+				});
+		assertion(same && offset == size);
+		postgres::unlink_large_object(con, oid);
+	}
+
+	void options_test(const std::string& uri) {
+		test_header("options_test");
+		// libpq keywords are passed on, options for other drivers are ignored
+		auto db = postgres::database(uri + "&connect_timeout=5&application_name=cppstddb&prefetch_rows=100");
+		auto r = db.connection().statement("select current_setting('application_name')").query().rows();
+		assertion(r.front()[0].str() == "cppstddb");
+	}
+
+	struct insert_score : statement_def<params<std::string,std::optional<int>>, results<>> {
+		static constexpr const char* sql = "insert into score(name,score) values($1,$2)";
+	};
+
+	struct scores_above : statement_def<params<int>, results<std::string,std::optional<int>>> {
+		static constexpr const char* sql = "select name,score from score where score > $1 order by score";
+	};
+
+}
+
 int main() {
 	try {
 		using namespace cppstddb;
 		test_all<postgres::database>(test_uri("postgres"));
+		timeout_test<postgres::database>(test_uri("postgres"), "select pg_sleep(30)");
+		large_object_test(test_uri("postgres"));
+		options_test(test_uri("postgres"));
+		typed_statement_test<postgres::database, insert_score, scores_above>(test_uri("postgres"));
+		write_queue_test<postgres::database, insert_score>(test_uri("postgres"));
 	} catch (exception &e) {
 		cout << "exception: " << e.what() << endl;
 	}
@@ -1,14 +1,449 @@
 #include <iostream>
 #include <cppstddb/sqlite/database.h>
+#include <cppstddb/sqlite/replica.h>
+#include <cppstddb/sqlite/checkpoint.h>
+#include <cppstddb/sqlite/pool.h>
+#include <cppstddb/sqlite/blob.h>
+#include <cstdio>
+#include <thread>
+#include <optional>
 #include <cppstddb/test_suite.h>
 
 using namespace std;
 
+namespace cppstddb {
+
+    void function_test(const std::string& uri) {
+        test_header("function_test");
+        auto db = sqlite::database(uri);
+        auto con = db.connection();
+
+        sqlite::create_function(con, "twice", [](long long x) {return 2 * x;});
+        sqlite::create_function(con, "initial", [](std::experimental::string_view s) {
+                return s.empty() ? std::string() : std::string(1, s[0]);});
+        sqlite::create_aggregate<long long>(con, "sum_sq",
+                [](long long& acc, int x) {acc += x * x;},
+                [](long long& acc) {return acc;});
+
+        auto r = con.statement("select twice(score), initial(name) from score").query().rows();
+        assertion(r.front()[0].as<int>() == 124);
+        assertion(r.front()[1].str() == "K");
+
+        auto s = con.statement("select sum_sq(score) from score").query().rows();
+        assertion(s.front()[0].as<int>() == 13204);
+
+        // no rows: final sees a value initialized state
+        s = con.statement("select sum_sq(score) from score where score < 0").query().rows();
+        assertion(s.front()[0].as<int>() == 0);
+
+#if SQLITE_VERSION_NUMBER >= 3025000
+        // a sliding frame runs value and inverse
+        sqlite::create_window_function<long long>(con, "sum_w",
+                [](long long& acc, int x) {acc += x;},
+                [](long long& acc, int x) {acc -= x;},
+                [](long long& acc) {return acc;});
+        auto w = con.statement(
+                "select sum_w(score) over (order by score rows between 1 preceding and current row) from score order by score")
+            .query().rows();
+        std::vector<int> sums;
+        for(; !w.empty(); w.next()) sums.push_back(w.front()[0].as<int>());
+        assertion(sums == std::vector<int>({48, 110, 146}));
+#endif
+    }
+
+    void prefetch_error_test(const std::string& uri) {
+        test_header("prefetch_error_test");
+        auto db = sqlite::database(uri);
+        auto con = db.connection();
+        sqlite::create_function(con, "checked", [](int score) {
+                if (score > 80) throw std::runtime_error("score out of range");
+                return score;});
+
+        // the rows before the failing one are delivered, then the error, every time
+        auto p = prefetch(con.statement("select name, checked(score) from score").query().rows());
+        std::vector<std::string> names;
+        int errors = 0;
+        for(int i = 0; i != 4; ++i) {
+            try {
+                if (p.empty()) break;
+                names.push_back(p.front()[0].as<std::string>());
+                p.pop_front();
+            } catch (database_error& e) {
+                ++errors;
+            }
+        }
+        assertion(names.size() == 2 && names[1] == "Hopper");
+        assertion(errors == 2);
+    }
+
+    struct person {
+        int id;
+        std::string name;
+        double weight;
+    };
+
+    void module_test(const std::string& uri) {
+        test_header("module_test");
+        auto db = sqlite::database(uri);
+        auto con = db.connection();
+
+        std::vector<person> people; // sorted by id
+        for(int i = 0; i != 1000; ++i) people.push_back({i, "p" + std::to_string(i), i * 0.5});
+
+        sqlite::create_module(con, "people", people,
+                sqlite::column("id", &person::id, true),
+                sqlite::column("name", &person::name),
+                sqlite::column("weight", &person::weight));
+
+        auto r = con.statement("select name from people where id = 42").query().rows();
+        assertion(r.front()[0].str() == "p42");
+
+        r = con.statement("select count(*) from people where id > 10 and id <= 20").query().rows();
+        assertion(r.front()[0].as<int>() == 10);
+
+        // values of another type than the key are not truncated
+        r = con.statement("select count(*) from people where id > 2.5 and id < 5.5").query().rows();
+        assertion(r.front()[0].as<int>() == 3);
+        r = con.statement("select count(*) from people where id < 2.5").query().rows();
+        assertion(r.front()[0].as<int>() == 3);
+        r = con.statement("select count(*) from people where id = 3.5").query().rows();
+        assertion(r.front()[0].as<int>() == 0);
+        // or outside the key type's range
+        r = con.statement("select count(*) from people where id < 4294967298").query().rows();
+        assertion(r.front()[0].as<int>() == 1000);
+        r = con.statement("select count(*) from people where id > -4294967294 and id < 3").query().rows();
+        assertion(r.front()[0].as<int>() == 3);
+
+        // join app side data with a table
+        r = con.statement("select count(*) from score s join people p on p.id = s.score").query().rows();
+        assertion(r.front()[0].as<int>() == 3);
+    }
+
+    void replica_test(const std::string& uri, const std::string& path) {
+        test_header("replica_test");
+        auto db = sqlite::database(uri);
+        auto con = db.connection();
+        sqlite::memory_replica replica(path);
+
+        auto count = [&db](const std::string& uri) {
+            auto con = db.connection(uri);
+            return con.statement("select count(*) from score").query().rows().front()[0].as<int>();
+        };
+
+        assertion(count(replica.uri()) == 3);
+
+        // file changes are not seen until a fresh snapshot is swapped in
+        con.statement("insert into score(name,score) values('Zed',9)").query();
+        auto old = db.connection(replica.uri());
+        assertion(count(replica.uri()) == 3);
+        replica.refresh();
+        assertion(count(replica.uri()) == 4);
+        assertion(old.statement("select count(*) from score").query().rows().front()[0].as<int>() == 3);
+
+        // replica changes are written back on request
+        db.connection(replica.uri()).statement("delete from score where name = 'Zed'").query();
+        assertion(count(uri) == 4);
+        replica.write_back();
+        assertion(count(uri) == 3);
+    }
+
+    void checkpoint_test(const std::string& path) {
+        test_header("checkpoint_test");
+        for(auto suffix : {"", "-wal", "-shm"}) std::remove((path + suffix).c_str());
+
+        auto db = sqlite::database("file://" + path);
+        auto con = db.connection();
+        con.statement("create table t (x integer, y text)").query();
+
+        sqlite::wal_checkpointer checkpointer(path, 16, 64, std::chrono::milliseconds(10));
+        checkpointer.attach(con);
+
+        for(int i = 0; i != 200; ++i) {
+            con.statement("insert into t values(" + std::to_string(i) + ", '" + std::string(512, 'x') + "')").query();
+        }
+
+        for(int i = 0; i != 500 && !checkpointer.stats().checkpoints; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        auto stats = checkpointer.stats();
+        cout << "checkpoints: " << stats.checkpoints
+            << ", max latency: " << stats.max_latency.count() << "us" << endl;
+        assertion(stats.checkpoints > 0);
+
+        assertion(checkpointer.checkpoint(SQLITE_CHECKPOINT_TRUNCATE));
+        assertion(checkpointer.stats().log_pages == 0);
+        checkpointer.detach(con);
+    }
+
+    void types_test(const std::string& uri) {
+        test_header("types_test");
+        auto db = sqlite::database(uri);
+        auto con = db.connection();
+        con.statement("drop table if exists typed").query();
+        con.statement("create table typed (i integer, r real, t text, b blob)").query();
+        con.statement("insert into typed values(1099511627776, 2.5, 'x', x'00ff')").query();
+        con.statement("insert into typed values(null, null, null, null)").query();
+
+        auto r = con.statement("select i, r, t, b, i * 2, r / 2 from typed").query().rows();
+        auto row = r.front();
+        assertion(row[0].type() == value_int64 && row[0].as<long long>() == 1099511627776LL);
+        assertion(row[1].type() == value_double && row[1].as<double>() == 2.5);
+        assertion(row[2].type() == value_string && row[2].str() == "x");
+        assertion(row[3].type() == value_blob);
+        auto b = row[3].as<std::vector<unsigned char>>();
+        assertion(b.size() == 2 && b[0] == 0 && b[1] == 0xff);
+        assertion(row[4].type() == value_int64 && row[5].type() == value_double);
+        assertion(!row[0].is_null());
+
+        row_snapshot s(row);
+        assertion(s[0].type() == value_int64 && s[0].as<long long>() == 1099511627776LL);
+        assertion(s[1].type() == value_double && s[2].view() == "x" && s[3].type() == value_blob);
+
+        r.next();
+        for(int c = 0; c != 4; ++c) assertion(row[c].is_null());
+        assertion(s[2].view() == "x" && row_snapshot(row)[0].is_null());
+    }
+
+    void writer_types_test(const std::string& uri) {
+        test_header("writer_types_test");
+        auto db = sqlite::database(uri);
+        auto con = db.connection();
+        con.statement("drop table if exists mixed").query();
+        con.statement("create table mixed (v integer, b blob)").query();
+        con.statement("insert into mixed values(1, x'00ff')").query();
+        con.statement("insert into mixed values('two', 'hi')").query();
+        con.statement("insert into mixed values(2.5, x'41')").query();
+
+        auto r = con.statement("select v, b from mixed").query().rows();
+        FILE* f = tmpfile();
+        write_json_lines(r, fileno(f));
+        auto s = read_file(f);
+        fclose(f);
+
+        std::cout << s;
+        assertion(s ==
+                "{\"v\":1,\"b\":\"00ff\"}\n"
+                "{\"v\":\"two\",\"b\":\"hi\"}\n"
+                "{\"v\":2.5,\"b\":\"41\"}\n");
+    }
+
+    void lob_test(const std::string& uri) {
+        test_header("lob_test");
+        auto db = sqlite::database(uri);
+        auto con = db.connection();
+        const size_t size = 3 << 20;
+        con.statement("drop table if exists lob").query();
+        con.statement("create table lob (id integer primary key, b blob)").query();
+        con.statement("insert into lob values(1, zeroblob(" + std::to_string(size) + "))").query();
+
+        // fill from a generator, one chunk at a time
+        size_t produced = 0;
+        sqlite::blob_stream out(con, "lob", "b", 1, true);
+        auto written = out.write_from([&produced](char* buf, size_t n) {
+                for(size_t i = 0; i != n; ++i) buf[i] = static_cast<char>((produced + i) % 251);
+                produced += n;
+                return n;
+                });
+        assertion(written == size);
+
+        size_t offset = 0;
+        bool same = true;
+        auto check = [&offset, &same](const char* p, size_t n) {
+            for(size_t i = 0; i != n; ++i) same &= p[i] == static_cast<char>((offset + i) % 251);
+            offset += n;
+        };
+
+        sqlite::blob_stream in(con, "lob", "b", 1);
+        in.read_chunks(check);
+        assertion(same && offset == size);
+
+        offset = 0;
+        auto r = con.statement("select b from lob where id = 1").query().rows();
+        r.front()[0].read_chunks(check, 4096);
+        assertion(same && offset == size);
+
+        row_snapshot s(r.front());
+        assertion(s[0].is_external() && s[0].view().size() == size);
+    }
+
+    void options_test(const std::string& uri) {
+        test_header("options_test");
+        auto src = uri_to_source("mysql://host:3307/db?socket=/tmp/my.sock&prefetch_rows=64&compress&port=3308");
+        assertion(src.server == "host:3307" && src.database == "db" && src.port == 3308);
+        assertion(src.option("socket") == "/tmp/my.sock");
+        assertion(src.option_int("prefetch_rows", 0) == 64);
+        assertion(src.option_bool("compress", false));
+
+        auto db = sqlite::database(uri + "?cache_size=-4000&synchronous=normal&busy_timeout=100&nomutex");
+        auto con = db.connection();
+        assertion(con.statement("pragma cache_size").query().rows().front()[0].as<int>() == -4000);
+        assertion(con.statement("pragma synchronous").query().rows().front()[0].as<int>() == 1);
+
+        bool thrown = false;
+        try {
+            sqlite::database(uri + "?journal_mode=wal;drop").connection();
+        } catch (database_error& e) {
+            thrown = true;
+        }
+        assertion(thrown);
+    }
+
+    void pool_test(const std::string& path) {
+        test_header("pool_test");
+        sqlite::read_pool<> pool("file://" + path, 4);
+
+        auto count = [&pool] {
+            auto con = pool.reader();
+            return con->statement("select count(*) from t").query().rows().front()[0].as<int>();
+        };
+        int n = count();
+
+        std::atomic<int> failures(0);
+        std::vector<std::thread> threads;
+        for(int i = 0; i != 8; ++i) {
+            threads.emplace_back([&] {
+                    try {
+                        for(int j = 0; j != 50; ++j) if (count() != n) ++failures;
+                    } catch (std::exception& e) {
+                        cout << "pool_test: " << e.what() << endl;
+                        ++failures;
+                    }
+                });
+        }
+        for(auto& t : threads) t.join();
+        assertion(failures == 0);
+
+        pool.writer()->statement("insert into t values(-1, 'w')").query();
+        assertion(count() == n + 1);
+
+        // a handle kept past its lease is still safe while the reader is leased again
+        auto kept = *pool.reader();
+        std::thread other([&] {for(int j = 0; j != 50; ++j) if (count() != n + 1) ++failures;});
+        for(int j = 0; j != 50; ++j) {
+            if (kept.statement("select count(*) from t").query().rows().front()[0].as<int>() != n + 1) ++failures;
+        }
+        other.join();
+        assertion(failures == 0);
+
+        bool thrown = false;
+        try {
+            pool.reader()->statement("insert into t values(-2, 'r')").query();
+        } catch (database_error& e) {
+            thrown = true; // readers are read only
+        }
+        assertion(thrown);
+
+        // a pool built where an old one was ignores the thread's last reader there
+        std::optional<sqlite::read_pool<>> reused;
+        reused.emplace("file://" + path, 4);
+        {
+            std::vector<sqlite::read_pool<>::lease> leases;
+            leases.reserve(4);
+            for(int i = 0; i != 4; ++i) leases.push_back(reused->reader());
+        }
+        reused.emplace("file://" + path, 1);
+        assertion(reused->reader()->statement("select count(*) from t").query().rows().front()[0].as<int>() == n + 1);
+    }
+
+    void long_scan_test(const std::string& uri) {
+        test_header("long_scan_test");
+        auto db = sqlite::database(uri);
+        const long long n = 100000;
+        auto rows = db.statement(
+                "with recursive c(x) as (select 1 union all select x + 1 from c where x < " +
+                std::to_string(n) + ") select x, 'row ' || x from c").query().rows();
+        long long sum = 0, count = 0;
+        for(auto& row : prefetch(rows, 256)) {
+            sum += row[0].as<long long>();
+            ++count;
+        }
+        assertion(count == n && sum == n * (n + 1) / 2);
+
+        auto scan = [&db, n] {
+            return db.statement(
+                    "with recursive c(x) as (select 1 union all select x + 1 from c where x < " +
+                    std::to_string(n) + ") select x, 'row ' || x from c").query().rows();
+        };
+        sum = parallel_reduce(scan(), 0LL,
+                [](long long& acc, const row_snapshot& row) {acc += row[0].as<long long>();},
+                [](long long& acc, const long long& other) {acc += other;});
+        assertion(sum == n * (n + 1) / 2);
+
+        long long last = 0;
+        parallel_transform(scan(), [](const row_snapshot& row) {return row[0].as<long long>();},
+                [&last](long long x) {assertion(x == last + 1); last = x;});
+        assertion(last == n);
+    }
+
+    struct insert_score : statement_def<params<std::string,std::optional<int>>, results<>> {
+        static constexpr const char* sql = "insert into score(name,score) values(?,?)";
+    };
+
+    struct scores_above : statement_def<params<int>, results<std::string,std::optional<int>>> {
+        static constexpr const char* sql = "select name,score from score where score > ? order by score";
+    };
+
+    struct insert_key : statement_def<params<int>, results<>> {
+        static constexpr const char* sql = "insert into wq(id) values(?)";
+    };
+
+    // a failed write leaves the rest of its batch committed
+    void write_queue_failure_test(const std::string& uri) {
+        test_header("write_queue_failure_test");
+        auto db = sqlite::database(uri);
+        db.query("drop table if exists wq");
+        db.query("create table wq(id integer primary key)");
+        std::vector<std::future<void>> done;
+        {
+            front::write_queue q(db, 16, std::chrono::milliseconds(50));
+            for(int id : {1, 2, 1, 3}) done.push_back(q.push<insert_key>(id));
+        }
+        done[0].get();
+        done[1].get();
+        done[3].get();
+        bool thrown = false;
+        try {
+            done[2].get();
+        } catch (database_error& e) {
+            thrown = true;
+        }
+        assertion(thrown);
+        assertion(db.query("select count(*) from wq").rows().front()[0].as<int>() == 3);
+    }
+
+}
+
 int main() {
     try {
 		using namespace cppstddb;
         string uri = "file://testdb.sqlite";
         test_all<sqlite::database>(uri);
+        function_test(uri);
+        module_test(uri);
+        prefetch_error_test(uri);
+        types_test(uri);
+        writer_types_test(uri);
+        lob_test(uri);
+        long_scan_test(uri);
+        typed_statement_test<sqlite::database, insert_score, scores_above>(uri);
+        write_queue_test<sqlite::database, insert_score>(uri);
+        write_queue_failure_test(uri);
+        options_test(uri);
+        replica_test(uri, "testdb.sqlite");
+        checkpoint_test("testdb_wal.sqlite");
+        pool_test("testdb_wal.sqlite");
+        timeout_test<sqlite::database>(uri,
+                "with recursive c(x) as (select 1 union all select x + 1 from c) "
+                "select count(*) from c");
+
+#ifdef CPPSTDDB_HAS_PMR
+        {
+            // everything allocated from one arena, released at end of scope
+            std::pmr::monotonic_buffer_resource arena;
+            scoped_resource scope(&arena);
+            test_all<sqlite::basic_database<pmr_policy>>(uri);
+        }
+#endif
     } catch (cppstddb::database_error &e) {
         cppstddb::vertical_print(cout, e);
     } catch (exception &e) {